@@ -0,0 +1,150 @@
+// Measures throughput of a get/put mix for 1..N threads, comparing a hashmap behind one
+// global mutex with chashmap, using read locks and with lock-free reads, and with shashmap.
+// Build: gcc -O2 -pthread -I. bench/concurrent.c hashmap_concurrent.c hashmap_epoch.c hashmap_sharded.c hashmap.c hashmap_hash.c -o concurrent
+// Usage: ./concurrent [max_threads] [puts_per_mille]
+
+#include "hashmap_concurrent.h"
+#include "hashmap_sharded.h"
+
+#include <time.h>
+
+#define BENCH_KEYS (1024 * 1024)  // Distinct keys the threads work on
+#define BENCH_OPS (2 * 1024 * 1024) // Operations per thread
+#define BENCH_PUTS_PER_MILLE 100  // Default share of puts in the mix
+
+static char **keys;
+static int putsPerMille = BENCH_PUTS_PER_MILLE;
+
+typedef struct bench_global
+{
+    pthread_mutex_t lock;
+    hashmap *map;
+} bench_global;
+
+typedef struct bench_thread
+{
+    chashmap *cmap;      // Map used by the striped runs, or NULL
+    shashmap *smap;      // Map used by the sharded run, or NULL
+    bench_global *gmap;  // Map used by the global mutex run, or NULL
+    uint64_t seed;
+} bench_thread;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void* worker(void *arg)
+{
+    bench_thread *t = arg;
+    uint64_t x = t->seed;
+    int value;
+    for (int i = 0; i < BENCH_OPS; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        const char *key = keys[x % BENCH_KEYS];
+        bool isPut = (x >> 32) % 1000 < (uint64_t)putsPerMille;
+        if (t->cmap) {
+            if (isPut) {
+                chm_put(t->cmap, key, i);
+            } else {
+                chm_get(t->cmap, key, &value);
+            }
+        } else if (t->smap) {
+            if (isPut) {
+                shd_put(t->smap, key, i);
+            } else {
+                shd_get(t->smap, key, &value);
+            }
+        } else {
+            pthread_mutex_lock(&t->gmap->lock);
+            if (isPut) {
+                put(t->gmap->map, key, i);
+            } else {
+                get(t->gmap->map, key, &value);
+            }
+            pthread_mutex_unlock(&t->gmap->lock);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs the mix on threadCount threads against one of the two maps.
+ * @return Throughput in millions of operations per second.
+ */
+static double run(int threadCount, chashmap *cmap, shashmap *smap, bench_global *gmap)
+{
+    pthread_t threads[threadCount];
+    bench_thread args[threadCount];
+
+    double start = now_seconds();
+    for (int t = 0; t < threadCount; t++) {
+        args[t] = (bench_thread){ cmap, smap, gmap, 88172645463325252ULL + t * 0x9E3779B97F4A7C15ULL };
+        pthread_create(&threads[t], NULL, worker, &args[t]);
+    }
+    for (int t = 0; t < threadCount; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    double elapsed = now_seconds() - start;
+    return (double)threadCount * BENCH_OPS / elapsed / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+    int maxThreads = argc > 1 ? atoi(argv[1]) : 8;
+    if (argc > 2) {
+        putsPerMille = atoi(argv[2]);
+    }
+    if (maxThreads <= 0 || putsPerMille < 0 || putsPerMille > 1000) {
+        fprintf(stderr, "Error: Invalid thread count or put share.\n");
+        return 1;
+    }
+
+    keys = malloc(BENCH_KEYS * sizeof(char*));
+    if (!keys) {
+        perror("Error: Failed to allocate benchmark keys");
+        return 1;
+    }
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        keys[i] = malloc(32);
+        snprintf(keys[i], 32, "user:%d:session", i);
+    }
+
+    // Both maps start with every key present, so the mix measures steady-state access
+    chashmap *cmap = c_chashmap(BENCH_KEYS, 0, hm_hash_wy, 0);
+    chashmap *lfmap = c_chashmap_ex(BENCH_KEYS, &(chashmap_options){ .hash_fn = hm_hash_wy, .lockfree_reads = true });
+    bench_global gmap = { .map = c_hashmap_ex(BENCH_KEYS, &(hashmap_options){ .hash_fn = hm_hash_wy }) };
+    shashmap *smap = c_shashmap(BENCH_KEYS, 0, &(hashmap_options){ .hash_fn = hm_hash_wy });
+    if (!cmap || !lfmap || !gmap.map || !smap) {
+        return 1;
+    }
+    pthread_mutex_init(&gmap.lock, NULL);
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        chm_put(cmap, keys[i], i);
+        chm_put(lfmap, keys[i], i);
+        shd_put(smap, keys[i], i);
+        put(gmap.map, keys[i], i);
+    }
+
+    printf("%.1f%% puts, %d ops per thread  (Mops/s)\n", putsPerMille / 10.0, BENCH_OPS);
+    printf("%8s %14s %14s %14s %14s\n", "threads", "global mutex", "striped", "lock-free get", "sharded");
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        printf("%8d %14.2f %14.2f %14.2f %14.2f\n", threads, run(threads, NULL, NULL, &gmap),
+               run(threads, cmap, NULL, NULL), run(threads, lfmap, NULL, NULL), run(threads, NULL, smap, NULL));
+    }
+
+    pthread_mutex_destroy(&gmap.lock);
+    d_hashmap(gmap.map);
+    d_chashmap(cmap);
+    d_chashmap(lfmap);
+    d_shashmap(smap);
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        free(keys[i]);
+    }
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,92 @@
+// Compares a loop of get() calls with get_many() on a map much larger than the caches.
+// Build: gcc -O2 -I. bench/get_many.c hashmap.c hashmap_hash.c -o get_many
+
+#include "hashmap.h"
+
+#include <time.h>
+
+#define BENCH_KEYS (2 * 1024 * 1024) // Keys in the map
+#define BENCH_LOOKUPS (4 * 1024 * 1024) // Lookups per measurement
+#define BENCH_BATCH 256              // Keys per get_many call, as a request handler would pass
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void run(const char *name, const hashmap_options *opts, char **keys, const char **order)
+{
+    hashmap* map = c_hashmap_ex(BENCH_KEYS, opts);
+    if (!map) {
+        return;
+    }
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        put(map, keys[i], i);
+    }
+
+    int values[BENCH_BATCH];
+    HashMapStatus statuses[BENCH_BATCH];
+    long long sum = 0;
+
+    double start = now_seconds();
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        int value;
+        if (get(map, order[i], &value) == HM_SUCCESS) {
+            sum += value;
+        }
+    }
+    double loop = now_seconds() - start;
+
+    start = now_seconds();
+    for (int i = 0; i < BENCH_LOOKUPS; i += BENCH_BATCH) {
+        get_many(map, order + i, BENCH_BATCH, values, statuses);
+        for (int j = 0; j < BENCH_BATCH; j++) {
+            if (statuses[j] == HM_SUCCESS) {
+                sum -= values[j];
+            }
+        }
+    }
+    double batched = now_seconds() - start;
+
+    printf("%-8s get loop %6.1f ns/key   get_many %6.1f ns/key   speedup %.2fx%s\n", name,
+           loop * 1e9 / BENCH_LOOKUPS, batched * 1e9 / BENCH_LOOKUPS, loop / batched,
+           sum == 0 ? "" : "   (MISMATCH)");
+    d_hashmap(map);
+}
+
+int main(void)
+{
+    char **keys = malloc(BENCH_KEYS * sizeof(char*));
+    const char **order = malloc(BENCH_LOOKUPS * sizeof(char*));
+    if (!keys || !order) {
+        perror("Error: Failed to allocate benchmark keys");
+        return 1;
+    }
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        keys[i] = malloc(32);
+        snprintf(keys[i], 32, "user:%d:session", i);
+    }
+    // Uniformly random lookups, every tenth one a miss
+    uint64_t x = 88172645463325252ULL;
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        order[i] = i % 10 == 9 ? "missing:key" : keys[x % BENCH_KEYS];
+    }
+
+    hashmap_options chained = { 0 };
+    hashmap_options swiss = { .engine = HM_ENGINE_SWISS };
+    chained.hash_fn = swiss.hash_fn = hm_hash_wy;
+    run("chained", &chained, keys, order);
+    run("swiss", &swiss, keys, order);
+
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        free(keys[i]);
+    }
+    free(keys);
+    free(order);
+    return 0;
+}
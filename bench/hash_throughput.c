@@ -0,0 +1,80 @@
+// Measures the throughput of the hash functions in GB/s for a range of key lengths.
+// Build: gcc -O2 -I. bench/hash_throughput.c hashmap.c hashmap_hash.c -o hash_throughput
+
+#include "hashmap.h"
+
+#include <time.h>
+
+#define BENCH_BYTES (256u * 1024 * 1024) // Bytes hashed per function and key length
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Hashes BENCH_BYTES worth of keys of one length, cycling through a buffer.
+ * @return Throughput in GB/s.
+ */
+static double run(hm_hash_fn fn, const unsigned char *buf, size_t bufLen, size_t keyLen)
+{
+    size_t iterations = BENCH_BYTES / keyLen;
+    size_t positions = bufLen - keyLen + 1;
+    volatile uint64_t sink = 0;
+    uint64_t acc = 0;
+
+    double start = now_seconds();
+    for (size_t i = 0; i < iterations; i++) {
+        // Vary the offset so successive calls do not hash identical bytes
+        acc += fn(buf + (i * 64) % positions, keyLen, acc);
+    }
+    double elapsed = now_seconds() - start;
+    sink = acc;
+    (void)sink;
+
+    return (double)iterations * keyLen / elapsed / 1e9;
+}
+
+int main(void)
+{
+    static const size_t lengths[] = { 16, 32, 64, 128, 256, 512, 1024, 4096 };
+    static const struct {
+        const char *name;
+        hm_hash_fn fn;
+    } fns[] = {
+        { "djb2", hm_hash_djb2 },
+        { "wy", hm_hash_wy },
+        { "simd-scalar", hm_hash_simd_scalar },
+        { "simd", hm_hash_simd },
+    };
+
+    size_t bufLen = 1 << 16;
+    unsigned char *buf = malloc(bufLen);
+    if (!buf) {
+        perror("Error: Failed to allocate benchmark buffer");
+        return 1;
+    }
+    for (size_t i = 0; i < bufLen; i++) {
+        buf[i] = (unsigned char)(i * 131 + 7);
+    }
+
+    printf("simd kernel: %s\n", hm_hash_simd_kernel());
+    printf("%8s", "bytes");
+    for (size_t f = 0; f < sizeof(fns) / sizeof(fns[0]); f++) {
+        printf(" %12s", fns[f].name);
+    }
+    printf("   (GB/s)\n");
+
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        printf("%8zu", lengths[l]);
+        for (size_t f = 0; f < sizeof(fns) / sizeof(fns[0]); f++) {
+            printf(" %12.2f", run(fns[f].fn, buf, bufLen, lengths[l]));
+        }
+        printf("\n");
+    }
+
+    free(buf);
+    return 0;
+}
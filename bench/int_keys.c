@@ -0,0 +1,118 @@
+// Compares integer IDs formatted into strings for the string-keyed hashmap with the same IDs
+// in u64map, for inserts and lookups.
+// Build: gcc -O2 -pthread -I. bench/int_keys.c hashmap.c hashmap_hash.c -o int_keys
+
+#include "hashmap_int.h"
+
+#include <inttypes.h>
+#include <time.h>
+
+#define BENCH_KEYS (4 * 1024 * 1024) // Distinct IDs inserted
+#define BENCH_LOOKUPS (8 * 1024 * 1024) // Lookups per measurement
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Inserts every ID into a string-keyed map and looks IDs up, formatting each one first
+ * as callers without an integer map have to.
+ */
+static void run_strings(const char *name, const hashmap_options *opts, const uint64_t *ids, const uint64_t *order)
+{
+    hashmap* map = c_hashmap_ex(16, opts);
+    if (!map) {
+        return;
+    }
+    char key[24];
+    long long sum = 0;
+
+    double start = now_seconds();
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        snprintf(key, sizeof(key), "%" PRIu64, ids[i]);
+        put(map, key, i);
+    }
+    double inserts = now_seconds() - start;
+
+    start = now_seconds();
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        int value;
+        snprintf(key, sizeof(key), "%" PRIu64, order[i]);
+        if (get(map, key, &value) == HM_SUCCESS) {
+            sum += value;
+        }
+    }
+    double lookups = now_seconds() - start;
+
+    printf("%-16s put %6.1f ns/key   get %6.1f ns/key   (checksum %lld)\n", name,
+           inserts * 1e9 / BENCH_KEYS, lookups * 1e9 / BENCH_LOOKUPS, sum);
+    d_hashmap(map);
+}
+
+/**
+ * @brief The same workload on u64map.
+ */
+static void run_u64map(const uint64_t *ids, const uint64_t *order)
+{
+    u64map* map = c_u64map(16);
+    if (!map) {
+        return;
+    }
+    long long sum = 0;
+
+    double start = now_seconds();
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        u64map_put(map, ids[i], i);
+    }
+    double inserts = now_seconds() - start;
+
+    start = now_seconds();
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        int value;
+        if (u64map_get(map, order[i], &value) == HM_SUCCESS) {
+            sum += value;
+        }
+    }
+    double lookups = now_seconds() - start;
+
+    printf("%-16s put %6.1f ns/key   get %6.1f ns/key   (checksum %lld)\n", "u64map",
+           inserts * 1e9 / BENCH_KEYS, lookups * 1e9 / BENCH_LOOKUPS, sum);
+    d_u64map(map);
+}
+
+int main(void)
+{
+    uint64_t *ids = malloc(BENCH_KEYS * sizeof(uint64_t));
+    uint64_t *order = malloc(BENCH_LOOKUPS * sizeof(uint64_t));
+    if (!ids || !order) {
+        perror("Error: Failed to allocate benchmark keys");
+        return 1;
+    }
+    // Sparse 64-bit IDs, as handed out by a database; every tenth lookup misses
+    uint64_t x = 88172645463325252ULL;
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        ids[i] = x >> 8;
+    }
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        order[i] = i % 10 == 9 ? UINT64_MAX : ids[x % BENCH_KEYS];
+    }
+
+    hashmap_options chained = { 0 };
+    hashmap_options swiss = { .engine = HM_ENGINE_SWISS, .hash_fn = hm_hash_wy };
+    run_strings("string chained", &chained, ids, order);
+    run_strings("string swiss+wy", &swiss, ids, order);
+    run_u64map(ids, order);
+
+    free(ids);
+    free(order);
+    return 0;
+}
@@ -0,0 +1,262 @@
+// Measures put, get (hit), get (miss), delete_key and resize across key distributions and key
+// lengths, and prints the results as JSON so runs on different commits can be compared.
+// Build: gcc -O2 -pthread -I. bench/ops.c hashmap.c hashmap_hash.c -lm -o ops
+// Usage: ./ops [--keys N] [--repeat N] [--swiss] [--wy] [--label TEXT] > results.json
+//
+// Distributions (each one a set of distinct keys plus the order lookups visit them in):
+//   uniform     scrambled IDs, looked up in uniformly random order
+//   sequential  consecutive IDs, looked up in insertion order
+//   zipfian     scrambled IDs, looked up with Zipf (s = 0.99) popularity, as hot keys are
+//   adversarial keys whose DJB2 hashes collide in groups of up to BENCH_COLLISION_GROUP,
+//               looked up in uniformly random order
+
+#include "hashmap.h"
+
+#include <math.h>
+#include <time.h>
+
+#define BENCH_DEFAULT_KEYS 100000  // Distinct keys per run
+#define BENCH_DEFAULT_REPEAT 3     // Runs per configuration; the fastest one is reported
+#define BENCH_COLLISION_GROUP 64   // Largest group of fully colliding adversarial keys
+#define BENCH_ZIPF_S 0.99          // Zipf exponent
+
+// Order of the operations in a result row
+enum { OP_PUT, OP_GET_HIT, OP_GET_MISS, OP_RESIZE, OP_DELETE, OP_COUNT };
+static const char *const op_names[OP_COUNT] = { "put", "get_hit", "get_miss", "resize", "delete_key" };
+
+enum { DIST_UNIFORM, DIST_SEQUENTIAL, DIST_ZIPFIAN, DIST_ADVERSARIAL, DIST_COUNT };
+static const char *const dist_names[DIST_COUNT] = { "uniform", "sequential", "zipfian", "adversarial" };
+
+static const int key_lens[] = { 8, 16, 32, 64, 128, 256 };
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t rng_state = 88172645463325252ULL;
+
+static uint64_t rng_next(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/**
+ * @brief Writes key number id of a distribution into key (len bytes plus a NUL). The first byte
+ * tells stored keys from missing ones; the ID goes at the end, behind a constant filler, as in
+ * "tenant/table/.../id" keys.
+ * @param miss Draw the key from a set disjoint from the stored keys.
+ */
+static void make_key(char *key, int len, int dist, uint64_t id, bool miss)
+{
+    memset(key, 'k', (size_t)len);
+    key[len] = '\0';
+    key[0] = miss ? 'm' : 'h';
+    if (dist != DIST_ADVERSARIAL) {
+        // As many hex digits as fit; random IDs are scrambled within that many bits, which
+        // keeps them distinct (multiplying by an odd number and xor-shifting are both bijective)
+        int digits = len - 1 < 16 ? len - 1 : 16;
+        int bits = digits * 4;
+        if (dist != DIST_SEQUENTIAL) {
+            uint64_t mask = bits == 64 ? ~0ULL : (1ULL << bits) - 1;
+            id = (id * 0x9E3779B97F4A7C15ULL) & mask;
+            id ^= id >> (bits / 2);
+        }
+        for (int i = 0; i < digits; i++, id >>= 4) {
+            key[len - 1 - i] = "0123456789abcdef"[id & 15];
+        }
+        return;
+    }
+
+    // "Ab" and "BA" have the same DJB2 hash and length, so any string of them collides with
+    // every other one of the same length. The hex digits pick the group, the blocks at the end
+    // the member (BENCH_COLLISION_GROUP = 2^6 members, fewer for keys too short for 6 blocks).
+    int blocks = (len - 5) / 2 < 6 ? (len - 5) / 2 : 6;
+    int digits = len - 1 - 2 * blocks;
+    uint64_t group = id >> blocks;
+    for (int i = 0; i < digits; i++, group >>= 4) {
+        key[digits - i] = "0123456789abcdef"[group & 15];
+    }
+    for (int b = 0; b < blocks; b++) {
+        memcpy(key + 1 + digits + 2 * b, (id >> b) & 1 ? "BA" : "Ab", 2);
+    }
+}
+
+/**
+ * @brief Fills order with n indices in [0, keys) drawn from a Zipf distribution.
+ */
+static void zipf_indices(int *order, int n, int keys)
+{
+    double *cdf = malloc((size_t)keys * sizeof(double));
+    double sum = 0;
+    for (int i = 0; i < keys; i++) {
+        sum += 1.0 / pow(i + 1, BENCH_ZIPF_S);
+        cdf[i] = sum;
+    }
+    for (int i = 0; i < n; i++) {
+        double u = (double)(rng_next() >> 11) / (double)(1ULL << 53) * sum;
+        int lo = 0, hi = keys - 1;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (cdf[mid] < u) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        // Spread the popular ranks over the key set so they do not share buckets by construction
+        order[i] = (int)(((uint64_t)lo * 2654435761u) % (uint64_t)keys);
+    }
+    free(cdf);
+}
+
+/**
+ * @brief Runs every operation once on a fresh map.
+ * @param ns Receives the time per operation of each OP_*.
+ */
+static void run_once(const hashmap_options *opts, int keys, int len, char *stored, char *missing, const int *order, double *ns)
+{
+    size_t stride = (size_t)len + 1;
+    hashmap* map = c_hashmap_ex(16, opts);
+    if (!map) {
+        exit(1);
+    }
+    long long sum = 0;
+
+    double start = now_seconds();
+    for (int i = 0; i < keys; i++) {
+        put(map, stored + (size_t)i * stride, i);
+    }
+    ns[OP_PUT] = (now_seconds() - start) * 1e9 / keys;
+
+    start = now_seconds();
+    for (int i = 0; i < keys; i++) {
+        int value;
+        if (get(map, stored + (size_t)order[i] * stride, &value) == HM_SUCCESS) {
+            sum += value;
+        }
+    }
+    ns[OP_GET_HIT] = (now_seconds() - start) * 1e9 / keys;
+
+    start = now_seconds();
+    for (int i = 0; i < keys; i++) {
+        int value;
+        if (get(map, missing + (size_t)order[i] * stride, &value) == HM_SUCCESS) {
+            sum -= value;
+        }
+    }
+    ns[OP_GET_MISS] = (now_seconds() - start) * 1e9 / keys;
+
+    // One doubling of the full map, reported per entry moved
+    start = now_seconds();
+    resize(map);
+    ns[OP_RESIZE] = (now_seconds() - start) * 1e9 / keys;
+
+    start = now_seconds();
+    for (int i = 0; i < keys; i++) {
+        delete_key(map, stored + (size_t)i * stride);
+    }
+    ns[OP_DELETE] = (now_seconds() - start) * 1e9 / keys;
+
+    if (sum < 0 || map->count != 0) {
+        fprintf(stderr, "Error: Benchmark map is inconsistent.\n");
+    }
+    d_hashmap(map);
+}
+
+int main(int argc, char **argv)
+{
+    int keys = BENCH_DEFAULT_KEYS;
+    int repeat = BENCH_DEFAULT_REPEAT;
+    const char *label = "";
+    hashmap_options opts = { 0 };
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--keys") == 0 && i + 1 < argc) {
+            keys = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--label") == 0 && i + 1 < argc) {
+            label = argv[++i];
+        } else if (strcmp(argv[i], "--swiss") == 0) {
+            opts.engine = HM_ENGINE_SWISS;
+        } else if (strcmp(argv[i], "--wy") == 0) {
+            opts.hash_fn = hm_hash_wy;
+        } else {
+            fprintf(stderr, "Usage: %s [--keys N] [--repeat N] [--swiss] [--wy] [--label TEXT]\n", argv[0]);
+            return 1;
+        }
+    }
+    // 8-byte keys have room for 7 hex digits of ID, or 5 of adversarial group and one block
+    if (keys <= 0 || keys > (1 << 21) || repeat <= 0) {
+        fprintf(stderr, "Error: --keys must be in [1, 2097152] and --repeat positive.\n");
+        return 1;
+    }
+    // Labels are written as JSON strings without escaping
+    for (const char *c = label; *c; c++) {
+        if (*c == '"' || *c == '\\' || (unsigned char)*c < 0x20) {
+            fprintf(stderr, "Error: --label may not contain quotes, backslashes or control characters.\n");
+            return 1;
+        }
+    }
+
+    size_t maxStride = (size_t)key_lens[sizeof(key_lens) / sizeof(key_lens[0]) - 1] + 1;
+    char *stored = malloc((size_t)keys * maxStride);
+    char *missing = malloc((size_t)keys * maxStride);
+    int *order = malloc((size_t)keys * sizeof(int));
+    if (!stored || !missing || !order) {
+        perror("Error: Failed to allocate benchmark keys");
+        return 1;
+    }
+
+    printf("{\n  \"benchmark\": \"hashmap_ops\",\n  \"label\": \"%s\",\n", label);
+    printf("  \"engine\": \"%s\",\n  \"hash\": \"%s\",\n", opts.engine == HM_ENGINE_SWISS ? "swiss" : "chained",
+           opts.hash_fn == hm_hash_wy ? "wy" : "default");
+    printf("  \"keys\": %d,\n  \"repeat\": %d,\n  \"results\": [", keys, repeat);
+
+    bool first = true;
+    for (int dist = 0; dist < DIST_COUNT; dist++) {
+        // The same order for every key length, so lengths compare like for like
+        if (dist == DIST_ZIPFIAN) {
+            zipf_indices(order, keys, keys);
+        } else {
+            for (int i = 0; i < keys; i++) {
+                order[i] = dist == DIST_SEQUENTIAL ? i : (int)(rng_next() % (uint64_t)keys);
+            }
+        }
+
+        for (size_t l = 0; l < sizeof(key_lens) / sizeof(key_lens[0]); l++) {
+            int len = key_lens[l];
+            size_t stride = (size_t)len + 1;
+            for (int i = 0; i < keys; i++) {
+                make_key(stored + (size_t)i * stride, len, dist, (uint64_t)i, false);
+                make_key(missing + (size_t)i * stride, len, dist, (uint64_t)i, true);
+            }
+
+            double best[OP_COUNT];
+            for (int r = 0; r < repeat; r++) {
+                double ns[OP_COUNT];
+                run_once(&opts, keys, len, stored, missing, order, ns);
+                for (int op = 0; op < OP_COUNT; op++) {
+                    best[op] = r == 0 || ns[op] < best[op] ? ns[op] : best[op];
+                }
+            }
+            for (int op = 0; op < OP_COUNT; op++) {
+                printf("%s\n    {\"distribution\": \"%s\", \"key_len\": %d, \"op\": \"%s\", \"ns_per_op\": %.2f, \"ops_per_sec\": %.0f}",
+                       first ? "" : ",", dist_names[dist], len, op_names[op], best[op], best[op] > 0 ? 1e9 / best[op] : 0.0);
+                first = false;
+            }
+            fflush(stdout);
+        }
+    }
+    printf("\n  ]\n}\n");
+
+    free(stored);
+    free(missing);
+    free(order);
+    return 0;
+}
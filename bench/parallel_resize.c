@@ -0,0 +1,71 @@
+// Measures the wall time of resize() on a large chained map for 1..N rehash threads.
+// Build: gcc -O2 -pthread -I. bench/parallel_resize.c hashmap.c hashmap_hash.c -o parallel_resize
+// Usage: ./parallel_resize [max_threads]
+
+#include "hashmap.h"
+
+#include <time.h>
+
+#define BENCH_KEYS (8 * 1024 * 1024) // Keys in the map when it is resized
+#define BENCH_BUCKETS (BENCH_KEYS / MAX_FACTOR) // Map size, so filling it triggers no resize
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Fills a map that may rehash on the given number of threads and times one doubling resize.
+ * @return Wall time of the resize in seconds, or a negative value on failure.
+ */
+static double run(int threads, bool pow2, char **keys)
+{
+    hashmap_options opts = { .resize_threads = threads, .pow2 = pow2, .arena = true, .hash_fn = hm_hash_wy };
+    hashmap* map = c_hashmap_ex((int)BENCH_BUCKETS, &opts);
+    if (!map) {
+        return -1;
+    }
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        put(map, keys[i], i);
+    }
+
+    double start = now_seconds();
+    HashMapStatus status = resize(map);
+    double elapsed = now_seconds() - start;
+
+    d_hashmap(map);
+    return status == HM_SUCCESS ? elapsed : -1;
+}
+
+int main(int argc, char **argv)
+{
+    int maxThreads = argc > 1 ? atoi(argv[1]) : 8;
+    if (maxThreads <= 0) {
+        fprintf(stderr, "Error: Invalid thread count.\n");
+        return 1;
+    }
+
+    char **keys = malloc(BENCH_KEYS * sizeof(char*));
+    if (!keys) {
+        perror("Error: Failed to allocate benchmark keys");
+        return 1;
+    }
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        keys[i] = malloc(32);
+        snprintf(keys[i], 32, "user:%d:session", i);
+    }
+
+    printf("resize() of %d keys  (ms)\n", BENCH_KEYS);
+    printf("%8s %10s %10s\n", "threads", "modulo", "pow2");
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        printf("%8d %10.1f %10.1f\n", threads, run(threads, false, keys) * 1e3, run(threads, true, keys) * 1e3);
+    }
+
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        free(keys[i]);
+    }
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,82 @@
+// Compares restarting from a snapshot with hm_open_mmap against rebuilding the map from
+// its source data, for growing map sizes, and the cost of lookups served from the mapping.
+// Build: gcc -O2 -pthread -I. bench/snapshot.c hashmap.c hashmap_hash.c -o snapshot
+// Usage: ./snapshot [snapshot_path]
+
+#include "hashmap.h"
+
+#include <time.h>
+
+#define BENCH_MAX_KEYS (4 * 1024 * 1024) // Largest map built
+#define BENCH_LOOKUPS (1024 * 1024)      // Lookups per measurement
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Sums the values of a sample of keys, to time lookups on a map.
+ */
+static double time_lookups(const hashmap* map, int keys, long long *sum)
+{
+    char key[32];
+    double start = now_seconds();
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        int value;
+        snprintf(key, sizeof(key), "key:%d", (int)(((unsigned)i * 2654435761u) % (unsigned)keys));
+        if (get(map, key, &value) == HM_SUCCESS) {
+            *sum += value;
+        }
+    }
+    return now_seconds() - start;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "bench_snapshot.hms";
+    char key[32];
+
+    for (int keys = 64 * 1024; keys <= BENCH_MAX_KEYS; keys *= 4) {
+        // Rebuilding is what a restart costs without a snapshot
+        double start = now_seconds();
+        hashmap* built = c_hashmap(16);
+        if (!built) {
+            return 1;
+        }
+        for (int i = 0; i < keys; i++) {
+            snprintf(key, sizeof(key), "key:%d", i);
+            put(built, key, i);
+        }
+        double rebuild = now_seconds() - start;
+
+        start = now_seconds();
+        if (hm_save(built, path) != HM_SUCCESS) {
+            d_hashmap(built);
+            return 1;
+        }
+        double save = now_seconds() - start;
+
+        start = now_seconds();
+        hashmap* mapped = hm_open_mmap(path);
+        double open = now_seconds() - start;
+        if (!mapped) {
+            d_hashmap(built);
+            return 1;
+        }
+
+        long long sum = 0;
+        double builtLookups = time_lookups(built, keys, &sum);
+        double mappedLookups = time_lookups(mapped, keys, &sum);
+
+        printf("%8d keys   rebuild %8.2f ms   save %8.2f ms   open %6.3f ms   get %6.1f ns (built) %6.1f ns (mapped)   (checksum %lld)\n",
+               keys, rebuild * 1e3, save * 1e3, open * 1e3,
+               builtLookups * 1e9 / BENCH_LOOKUPS, mappedLookups * 1e9 / BENCH_LOOKUPS, sum);
+        d_hashmap(mapped);
+        d_hashmap(built);
+    }
+    remove(path);
+    return 0;
+}
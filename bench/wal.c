@@ -0,0 +1,81 @@
+// Measures logged puts per second through a write-ahead log for different group commit
+// sizes, from an fsync per operation up to large groups, against puts without a log.
+// Build: gcc -O2 -pthread -I. bench/wal.c hashmap_wal.c hashmap.c hashmap_hash.c -o wal
+// Usage: ./wal [log_path]   (put the log on the device whose fsync latency matters)
+
+#include "hashmap_wal.h"
+
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_SECONDS 0.5 // Minimum time per measurement
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Runs puts for BENCH_SECONDS, through a fresh log if opts is not NULL.
+ * @return Operations per second.
+ */
+static double run(const char *path, const hm_wal_options *opts)
+{
+    hashmap* map = c_hashmap(1024);
+    if (!map) {
+        return 0;
+    }
+    hm_wal* wal = NULL;
+    if (opts) {
+        unlink(path);
+        wal = hm_wal_open(path, map, opts);
+        if (!wal) {
+            d_hashmap(map);
+            return 0;
+        }
+    }
+
+    char key[32];
+    long ops = 0;
+    double start = now_seconds();
+    double elapsed;
+    do {
+        // Check the clock every 64 operations
+        for (int i = 0; i < 64; i++, ops++) {
+            snprintf(key, sizeof(key), "key:%ld", ops % 100000);
+            if (wal) {
+                hm_wal_put(wal, key, (int)ops);
+            } else {
+                put(map, key, (int)ops);
+            }
+        }
+    } while ((elapsed = now_seconds() - start) < BENCH_SECONDS);
+    if (wal) {
+        hm_wal_close(wal);
+        unlink(path);
+    }
+    d_hashmap(map);
+    return ops / elapsed;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "bench_wal.log";
+    static const int groups[] = { 1, 8, 64, 512, 4096 };
+
+    double base = run(path, NULL);
+    printf("%-22s %12.0f ops/s\n", "no log", base);
+    for (size_t i = 0; i < sizeof(groups) / sizeof(groups[0]); i++) {
+        hm_wal_options opts = { .sync_every = groups[i] };
+        double rate = run(path, &opts);
+        printf("sync every %-5d ops   %12.0f ops/s   %8.1f us/op   (a crash loses up to %d ops)\n",
+               groups[i], rate, 1e6 / rate, groups[i] - 1);
+    }
+    // A time bound caps how long an operation can stay uncommitted whatever the rate
+    hm_wal_options opts = { .sync_every = 1 << 20, .sync_interval_us = 1000 };
+    double rate = run(path, &opts);
+    printf("%-22s %12.0f ops/s   %8.1f us/op\n", "sync every 1 ms", rate, 1e6 / rate);
+    return 0;
+}
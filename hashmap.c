@@ -1,280 +1,2538 @@
-#pragma GCC optimize("O3")
-
-#include "hashmap.h"
-
-/**
- * @brief Computes a hash value for a given string using the DJB2 algorithm.
- * @param string The input string to hash.
- * @return An unsigned long hash value.
- */
-unsigned long hash(const char* string)
-{
-    unsigned long hash_val = 5381; // DJB2
-    int c;
-
-    while ((c = *string++)) {
-        // hash * 33 + c
-        hash_val = ((hash_val << 5) + hash_val) + c;
-    }
-
-    return hash_val;
-}
-
-/**
- * @brief Creates and initializes a new hashmap.
- * @param size The desired number of buckets for the hashmap.
- * @return A pointer to the newly created hashmap, or NULL if memory allocation fails.
- */
-hashmap* c_hashmap(int size)
-{
-    // Validate input size
-    if (size <= 0) {
-        fprintf(stderr, "Error: Hashmap size must be positive.\n");
-        return NULL;
-    }
-
-    // Allocate memory for the hashmap structure
-    hashmap* map = malloc(sizeof(hashmap));
-    if (!map) {
-        perror("Error: Failed to allocate memory for hashmap");
-        return NULL;
-    }
-
-    map->size = size;
-    map->count = 0; // Initialize count to 0
-    // Allocate memory for the array of bucket pointers and initialize them to NULL
-    map->buckets = calloc(size, sizeof(pair*)); // calloc initializes memory to zero (NULL for pointers)
-    if (!map->buckets) {
-        perror("Error: Failed to allocate memory for hashmap buckets");
-        free(map); // Free the hashmap structure if bucket allocation fails
-        return NULL;
-    }
-
-    return map;
-}
-
-/**
- * @brief Inserts a new key-value pair into the hashmap, or updates the value if the key already exists.
- * @param map A pointer to the hashmap.
- * @param key The string key.
- * @param value The integer value.
- * @return HashMapStatus indicating success or failure type.
- */
-HashMapStatus put(hashmap* map, const char *key, int value)
-{
-    // Validate inputs
-    if (!map || !key) {
-        fprintf(stderr, "Error: Invalid hashmap or key provided to put.\n");
-        return HM_ERR_INVALID_ARG;
-    }
-
-    // Calculate the index for the key using the HASH_INDEX macro
-    unsigned long index = HASH_INDEX(key, map->size);
-
-    // Traverse the linked list at the calculated index to check if the key already exists
-    pair* current = map->buckets[index];
-    while (current) {
-        if (strcmp(current->key, key) == 0) {
-            // Key found, update its value and return
-            current->value = value;
-            return HM_SUCCESS;
-        }
-        current = current->next;
-    }
-
-    // If the key does not exist, create a new pair
-    pair* new_pair = malloc(sizeof(pair));
-    if (!new_pair) {
-        perror("Error: Failed to allocate memory for new pair");
-        return HM_ERR_MALLOC_FAILED;
-    }
-
-    // Allocate memory for the key string and copy it
-    new_pair->key = malloc(strlen(key) + 1);
-    if (!new_pair->key) {
-        perror("Error: Failed to allocate memory for key string");
-        free(new_pair);
-        return HM_ERR_MALLOC_FAILED;
-    }
-    strcpy(new_pair->key, key);
-
-    new_pair->value = value;
-    // Insert the new pair at the head of the linked list in the bucket
-    new_pair->next = map->buckets[index];
-    map->buckets[index] = new_pair;
-    map->count++; // Increment count when a new pair is added
-
-    // If a new pair was successfully added (map->count was incremented):
-    if (LOAD_FACTOR(map) > MAX_FACTOR) {
-        HashMapStatus status = resize(map);
-        if (status != HM_SUCCESS) {
-            fprintf(stderr, "Warning: Hashmap resize failed after put.\n");
-            return HM_ERR_REHASHING_FAILED;
-        }
-    }
-
-    return HM_SUCCESS;
-}
-
-/**
- * @brief Retrieves the value associated with a given key from the hashmap.
- * @param map A constant pointer to the hashmap (data won't be modified).
- * @param key The string key to search for.
- * @param value Pointer to store the retrieved value.
- * @return HashMapStatus indicating success or failure type.
- */
-HashMapStatus get(const hashmap* map, const char *key, int *value)
-{
-    // Validate inputs
-    if (!map || !key || !value) {
-        fprintf(stderr, "Error: Invalid hashmap, key, or value pointer provided to get.\n");
-        return HM_ERR_INVALID_ARG;
-    }
-
-    // Calculate the index for the key using the HASH_INDEX macro
-    unsigned long index = HASH_INDEX(key, map->size);
-    pair* current = map->buckets[index];
-
-    // Traverse the linked list at the calculated index
-    while (current) {
-        if (strcmp(current->key, key) == 0) {
-            *value = current->value; // Key found, store its value
-            return HM_SUCCESS;
-        }
-        current = current->next;
-    }
-
-    return HM_ERR_KEY_NOT_FOUND;
-}
-
-/**
- * @brief Deletes a key-value pair from the hashmap.
- * @param map A pointer to the hashmap.
- * @param key The string key of the pair to delete.
- * @return HashMapStatus indicating success or failure type.
- */
-HashMapStatus delete_key(hashmap* map, const char *key)
-{
-    // Validate inputs
-    if (!map || !key) {
-        fprintf(stderr, "Error: Invalid hashmap or key provided to delete_key.\n");
-        return HM_ERR_INVALID_ARG;
-    }
-
-    // Calculate the index for the key using the HASH_INDEX macro
-    unsigned long index = HASH_INDEX(key, map->size);
-    pair* current = map->buckets[index];
-    pair* prev = NULL; // Pointer to the previous pair in the linked list
-
-    // Traverse the linked list to find the key to delete
-    while (current) {
-        if (strcmp(current->key, key) == 0) {
-            // Key found, remove it from the linked list
-            if (prev) {
-                prev->next = current->next; // Link previous to next, bypassing current
-            } else {
-                map->buckets[index] = current->next; // If deleting head, update bucket pointer
-            }
-
-            // Free the memory for the key string and the pair structure
-            free(current->key);
-            free(current);
-            map->count--; // Decrement count when a pair is deleted
-            return HM_SUCCESS;
-        }
-        prev = current;      // Move prev to current
-        current = current->next; // Move current to next
-    }
-
-    return HM_ERR_KEY_NOT_FOUND;
-}
-
-/**
- * @brief Resizes the hashmap by creating a new, larger array of buckets
- * and re-hashing all existing key-value pairs into the new structure.
- * @param map A pointer to the hashmap to be resized.
- * @return HashMapStatus indicating success or failure type.
- */
-HashMapStatus resize(hashmap* map)
-{
-    // Validate input
-    if (!map) {
-        fprintf(stderr, "Error: Invalid hashmap provided to resize.\n");
-        return HM_ERR_INVALID_ARG;
-    }
-
-    // Calculate the new size (double the current size)
-    size_t newSize;
-    if (__builtin_mul_overflow(map->size, 2, &newSize)) {
-        fprintf(stderr, "Error: Cannot resize hashmap - size overflow.\n");
-        return HM_ERR_SIZE_LIMIT;
-    }
-
-    // Allocate memory for the new array of buckets and initialize to NULL
-    pair** newBuckets = calloc(newSize, sizeof(pair*));
-    if (!newBuckets) {
-        fprintf(stderr, "Error: Failed to allocate memory for new buckets during resize.\n");
-        return HM_ERR_MALLOC_FAILED;
-    }
-
-    // Store old buckets and old size before modifying the map structure
-    pair** oldBuckets = map->buckets;
-    int oldSize = map->size;
-
-    // Update map's properties to the new values immediately.
-    map->size = newSize;
-    map->buckets = newBuckets;
-    map->count = 0; 
-
-    // Iterate through each bucket in the old hashmap
-    for (int i = 0; i < oldSize; i++) {
-        pair* current = oldBuckets[i];
-        // Traverse the linked list in the current old bucket
-        while (current) {
-            pair* temp = current;
-            current = current->next; // Move to the next pair in the old list before processing temp
-
-            // Calculate the new index for the current pair's key in the new hashmap
-            unsigned long newIndex = HASH_INDEX(temp->key, map->size); 
-
-            // Insert the current pair (temp) at the head of the linked list
-            // in the appropriate new bucket. 
-            temp->next = map->buckets[newIndex];
-            map->buckets[newIndex] = temp;
-            map->count++; // Increment count for each re-inserted element
-        }
-    }
-
-    // Free the memory allocated for the old array of buckets
-    free(oldBuckets);
-
-    return HM_SUCCESS;
-}
-
-/**
- * @brief Frees all memory allocated for the hashmap.
- * @param map A pointer to the hashmap to be deallocated.
- */
-void d_hashmap(hashmap* map)
-{
-    if (!map) {
-        return; // Nothing to free if map is NULL
-    }
-
-    // Iterate through each bucket
-    for (int i = 0; i < map->size; i++) {
-        pair* current = map->buckets[i];
-        // Traverse the linked list in the current bucket and free each pair
-        while (current) {
-            pair* temp = current; // Store current pair to free it
-            current = current->next; // Move to the next pair before freeing temp
-            free(temp->key);         // Free the dynamically allocated key string
-            free(temp);              // Free the pair structure itself
-        }
-    }
-
-    // Free the array of bucket pointers
-    free(map->buckets);
-    // Free the hashmap structure itself
-    free(map);
-}
+#pragma GCC optimize("O3")
+
+#include "hashmap.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Computes a hash value for a given string using the DJB2 algorithm.
+ * @param string The input string to hash.
+ * @return An unsigned long hash value.
+ */
+unsigned long hash(const char* string)
+{
+    unsigned long hash_val = 5381; // DJB2
+    int c;
+
+    while ((c = *string++)) {
+        // hash * 33 + c
+        hash_val = ((hash_val << 5) + hash_val) + c;
+    }
+
+    return hash_val;
+}
+
+/* ---------------------------------------------------------------------------
+ * Arena allocation
+ *
+ * With opts->arena set, pairs and key strings are carved out of large slabs
+ * instead of being malloc'd one by one. Freed pairs go onto a per-map freelist
+ * and freed key blocks onto one freelist per HM_ARENA_CLASS_SIZE size class, so
+ * a map with steady churn stops calling the general allocator altogether.
+ * d_hashmap then only has to release the slabs. Keys longer than the largest
+ * size class still use malloc and are counted so d_hashmap knows whether it
+ * has to look for them.
+ * ------------------------------------------------------------------------- */
+
+/**
+ * @brief Carves a block out of the newest slab of an arena, adding a slab if it is full.
+ * @param arena The arena to allocate from.
+ * @param size The block size in bytes (a multiple of 8).
+ * @return The block, or NULL if a new slab could not be allocated.
+ */
+static void* arena_carve(hm_arena* arena, size_t size)
+{
+    hm_slab* slab = arena->slabs;
+    if (!slab || slab->cap - slab->used < size) {
+        size_t cap = size > HM_SLAB_SIZE ? size : HM_SLAB_SIZE;
+        slab = malloc(sizeof(hm_slab) + cap);
+        if (!slab) {
+            return NULL;
+        }
+        slab->cap = cap;
+        slab->used = 0;
+        slab->next = arena->slabs;
+        arena->slabs = slab;
+    }
+    void* block = slab->data + slab->used;
+    slab->used += size;
+    return block;
+}
+
+/**
+ * @brief Allocates a pair, from the map's arena when it has one.
+ * @param map A pointer to the hashmap the pair will belong to.
+ * @return The (uninitialized) pair, or NULL if memory allocation fails.
+ */
+static pair* pair_alloc(hashmap* map)
+{
+    hm_arena* arena = map->arena;
+    if (!arena) {
+        return malloc(sizeof(pair));
+    }
+    if (arena->free_pairs) {
+        pair* p = arena->free_pairs;
+        arena->free_pairs = p->next;
+        return p;
+    }
+    return arena_carve(arena, (sizeof(pair) + 7) & ~(size_t)7);
+}
+
+/**
+ * @brief Releases a pair allocated with pair_alloc (but not its key).
+ * @param map A pointer to the hashmap the pair belongs to.
+ * @param p The pair to release.
+ */
+static void pair_free(hashmap* map, pair* p)
+{
+    if (!map->arena) {
+        free(p);
+        return;
+    }
+    p->next = map->arena->free_pairs;
+    map->arena->free_pairs = p;
+}
+
+/**
+ * @brief Allocates a NUL-terminated copy of a key, from the map's arena when it has one.
+ * @param map A pointer to the hashmap the key will belong to.
+ * @param key The key to copy.
+ * @param len The length of the key, not counting the NUL.
+ * @return The copy, or NULL if memory allocation fails.
+ */
+static char* key_alloc(hashmap* map, const char *key, size_t len)
+{
+    size_t size = len + 1;
+    char* copy;
+    hm_arena* arena = map->arena;
+
+    if (!arena || size > HM_ARENA_CLASS_SIZE * HM_ARENA_CLASSES) {
+        copy = malloc(size);
+        if (copy && arena) {
+            arena->large_count++;
+        }
+    } else {
+        int cls = (int)((size - 1) / HM_ARENA_CLASS_SIZE);
+        copy = arena->free_blocks[cls];
+        if (copy) {
+            arena->free_blocks[cls] = *(void**)copy;
+        } else {
+            copy = arena_carve(arena, (size_t)(cls + 1) * HM_ARENA_CLASS_SIZE);
+        }
+    }
+
+    if (copy) {
+        memcpy(copy, key, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+/**
+ * @brief Releases a key allocated with key_alloc.
+ * @param map A pointer to the hashmap the key belongs to.
+ * @param key The key to release.
+ * @param len The length of the key, not counting the NUL.
+ */
+static void key_free(hashmap* map, char *key, size_t len)
+{
+    hm_arena* arena = map->arena;
+    size_t size = len + 1;
+
+    if (!arena || size > HM_ARENA_CLASS_SIZE * HM_ARENA_CLASSES) {
+        free(key);
+        if (arena) {
+            arena->large_count--;
+        }
+        return;
+    }
+    int cls = (int)((size - 1) / HM_ARENA_CLASS_SIZE);
+    *(void**)key = arena->free_blocks[cls];
+    arena->free_blocks[cls] = key;
+}
+
+/**
+ * @brief Stores a copy of a key in a pair: inline when it fits, in a separate allocation otherwise.
+ * @param map A pointer to the hashmap the pair belongs to.
+ * @param p The pair.
+ * @param key The key to copy.
+ * @param len The length of the key, not counting the NUL.
+ * @return HashMapStatus indicating success or failure type.
+ */
+static HashMapStatus pair_set_key(hashmap* map, pair* p, const char *key, size_t len)
+{
+    p->key_len = (uint32_t)len;
+    if (len < HM_INLINE_KEY_SIZE) {
+        memcpy(p->key.inline_key, key, len);
+        p->key.inline_key[len] = '\0';
+        return HM_SUCCESS;
+    }
+    p->key.heap_key = key_alloc(map, key, len);
+    return p->key.heap_key ? HM_SUCCESS : HM_ERR_MALLOC_FAILED;
+}
+
+/**
+ * @brief Releases a pair together with its key.
+ * @param map A pointer to the hashmap the pair belongs to.
+ * @param p The pair to release.
+ */
+static void pair_release(hashmap* map, pair* p)
+{
+    if (p->key_len >= HM_INLINE_KEY_SIZE) {
+        key_free(map, p->key.heap_key, p->key_len);
+    }
+    pair_free(map, p);
+}
+
+/**
+ * @brief Checks whether a pair holds a given key. The cached hash and the length reject
+ * almost every mismatch before the key bytes (inline for short keys) are compared.
+ * @param p The pair.
+ * @param key The key to compare against.
+ * @param len The length of the key.
+ * @param h The hash of the key.
+ * @return true if the pair's key equals key.
+ */
+static inline bool pair_matches(const pair* p, const char *key, size_t len, uint64_t h)
+{
+    return p->hash == h && p->key_len == len && memcmp(pair_key(p), key, len) == 0;
+}
+
+/**
+ * @brief Releases every slab of an arena, and the arena itself.
+ * @param arena The arena to destroy, or NULL.
+ */
+static void arena_destroy(hm_arena* arena)
+{
+    if (!arena) {
+        return;
+    }
+    hm_slab* slab = arena->slabs;
+    while (slab) {
+        hm_slab* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    free(arena);
+}
+
+/* ---------------------------------------------------------------------------
+ * Swiss engine
+ *
+ * Slots live in one flat array with a parallel array of control bytes. The hash
+ * is split into H1 (the high bits, which choose the first group to probe) and
+ * H2 (the low 7 bits, stored in the control byte of a full slot). A probe loads
+ * HM_GROUP_WIDTH control bytes at once and only touches the slots whose control
+ * byte matches H2, so a lookup usually reads one control line and one slot line.
+ * ------------------------------------------------------------------------- */
+
+/**
+ * @brief Hashes a key for the swiss engine. H1 and H2 come from the high and low bits,
+ * so the hash is mixed in case the map's hash function leaves either of them weak.
+ * @param map A constant pointer to a swiss hashmap.
+ * @param key The string key.
+ * @param len The length of the key.
+ * @return The mixed hash.
+ */
+static inline uint64_t swiss_hash(const hashmap* map, const char *key, size_t len)
+{
+    return hm_mix64(map->hash_fn(key, len, map->seed));
+}
+
+/**
+ * @brief Allocates empty control and slot arrays for a swiss map.
+ * @param capacity The number of slots (a power of two, at least HM_GROUP_WIDTH).
+ * @param ctrl Output for the control byte array.
+ * @param slots Output for the slot array.
+ * @return HashMapStatus indicating success or failure type.
+ */
+static HashMapStatus swiss_alloc(int capacity, int8_t **ctrl, hm_slot **slots)
+{
+    *ctrl = malloc((size_t)capacity);
+    *slots = malloc((size_t)capacity * sizeof(hm_slot));
+    if (!*ctrl || !*slots) {
+        free(*ctrl);
+        free(*slots);
+        return HM_ERR_MALLOC_FAILED;
+    }
+    memset(*ctrl, HM_CTRL_EMPTY, (size_t)capacity);
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Finds the slot holding a key.
+ * @param map A constant pointer to a swiss hashmap.
+ * @param key The key to search for.
+ * @param len The length of the key.
+ * @param h The mixed hash of the key.
+ * @return The slot index, or -1 if the key is not present.
+ */
+static int swiss_find(const hashmap* map, const char *key, size_t len, uint64_t h)
+{
+    int groupMask = map->size / HM_GROUP_WIDTH - 1;
+    int group = (int)(HM_H1(h) & (uint64_t)groupMask);
+    int8_t tag = HM_H2(h);
+
+    // Triangular probing over whole groups visits every group once when the group count is a power of two
+    for (int step = 1; ; step++) {
+        const int8_t *ctrl = map->ctrl + (size_t)group * HM_GROUP_WIDTH;
+        for (uint32_t match = hm_group_match(ctrl, tag); match; match &= match - 1) {
+            int index = group * HM_GROUP_WIDTH + __builtin_ctz(match);
+            const hm_slot *slot = &map->slots[index];
+            if (slot->hash == h && slot->key_len == len && memcmp(slot->key, key, len) == 0) {
+                return index;
+            }
+        }
+        // A group with an EMPTY slot ends every probe sequence that reaches it
+        if (hm_group_match(ctrl, HM_CTRL_EMPTY)) {
+            return -1;
+        }
+        group = (group + step) & groupMask;
+    }
+}
+
+/**
+ * @brief Moves every live slot of a swiss map into freshly allocated arrays of the given capacity.
+ * This both grows the map and clears out DELETED tombstones.
+ * @param map A pointer to a swiss hashmap.
+ * @param newCapacity The new number of slots (a power of two, at least HM_GROUP_WIDTH).
+ * @return HashMapStatus indicating success or failure type.
+ */
+static HashMapStatus swiss_rehash(hashmap* map, int newCapacity)
+{
+    int8_t *newCtrl;
+    hm_slot *newSlots;
+    if (swiss_alloc(newCapacity, &newCtrl, &newSlots) != HM_SUCCESS) {
+        fprintf(stderr, "Error: Failed to allocate memory for new slots during resize.\n");
+        return HM_ERR_MALLOC_FAILED;
+    }
+
+    for (int i = 0; i < map->size; i++) {
+        if (map->ctrl[i] < 0) {
+            continue; // EMPTY or DELETED
+        }
+        // The cached hash spares reading the key
+        uint64_t h = map->slots[i].hash;
+        int index = hm_find_free(newCtrl, newCapacity, h);
+        newCtrl[index] = HM_H2(h);
+        newSlots[index] = map->slots[i];
+    }
+
+    free(map->ctrl);
+    free(map->slots);
+    map->ctrl = newCtrl;
+    map->slots = newSlots;
+    map->size = newCapacity;
+    map->growth_left = hm_growth_cap(newCapacity) - map->count;
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Makes room for one more insert into an EMPTY slot, growing the map if it is really full
+ * or just dropping tombstones if deletes used up the growth budget.
+ * @param map A pointer to a swiss hashmap whose growth budget is exhausted.
+ * @return HashMapStatus indicating success or failure type.
+ */
+static HashMapStatus swiss_reserve_one(hashmap* map)
+{
+    if (map->count < hm_growth_cap(map->size) / 2) {
+        return swiss_rehash(map, map->size); // Mostly tombstones, rehash in place
+    }
+    return resize(map);
+}
+
+/**
+ * @brief Swiss engine implementation of put_n, for a key already hashed with swiss_hash.
+ */
+static HashMapStatus swiss_put(hashmap* map, const char *key, size_t len, uint64_t h, int value)
+{
+    int index = swiss_find(map, key, len, h);
+    if (index >= 0) {
+        map->slots[index].value = value;
+        return HM_SUCCESS;
+    }
+
+    // Allocate the key copy before touching the table so a failure leaves the map unchanged
+    char *keyCopy = key_alloc(map, key, len);
+    if (!keyCopy) {
+        perror("Error: Failed to allocate memory for key string");
+        return HM_ERR_MALLOC_FAILED;
+    }
+
+    index = hm_find_free(map->ctrl, map->size, h);
+    if (map->ctrl[index] == HM_CTRL_EMPTY && map->growth_left == 0) {
+        HashMapStatus status = swiss_reserve_one(map);
+        if (status != HM_SUCCESS) {
+            key_free(map, keyCopy, len);
+            fprintf(stderr, "Warning: Hashmap resize failed during put.\n");
+            return HM_ERR_REHASHING_FAILED;
+        }
+        index = hm_find_free(map->ctrl, map->size, h);
+    }
+
+    if (map->ctrl[index] == HM_CTRL_EMPTY) {
+        map->growth_left--; // Reusing a tombstone does not shorten any probe sequence
+    }
+    map->ctrl[index] = HM_H2(h);
+    map->slots[index].key = keyCopy;
+    map->slots[index].hash = h;
+    map->slots[index].key_len = (uint32_t)len;
+    map->slots[index].value = value;
+    map->count++;
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Empties a full slot of a swiss map, freeing its key.
+ * @param map A pointer to a swiss hashmap.
+ * @param index The slot.
+ */
+static void swiss_erase_slot(hashmap* map, int index)
+{
+    key_free(map, map->slots[index].key, map->slots[index].key_len);
+    // If the group still has an EMPTY slot, every probe through it already stops here,
+    // so the slot can go straight back to EMPTY instead of becoming a tombstone.
+    int8_t *group = map->ctrl + (size_t)(index / HM_GROUP_WIDTH) * HM_GROUP_WIDTH;
+    if (hm_group_match(group, HM_CTRL_EMPTY)) {
+        map->ctrl[index] = HM_CTRL_EMPTY;
+        map->growth_left++;
+    } else {
+        map->ctrl[index] = HM_CTRL_DELETED;
+    }
+    map->count--;
+}
+
+/**
+ * @brief Swiss engine implementation of delete_n, for a key already hashed with swiss_hash.
+ */
+static HashMapStatus swiss_delete(hashmap* map, const char *key, size_t len, uint64_t h)
+{
+    int index = swiss_find(map, key, len, h);
+    if (index < 0) {
+        return HM_ERR_KEY_NOT_FOUND;
+    }
+    swiss_erase_slot(map, index);
+    return HM_SUCCESS;
+}
+
+/* ---------------------------------------------------------------------------
+ * Incremental rehashing (chained engine)
+ *
+ * With opts->incremental set, growing the map only allocates the new bucket
+ * array. The old array is kept next to it and put/delete_key each migrate
+ * HM_REHASH_STEP old buckets, so no single call pays for the whole rehash.
+ * Lookups only read: they search whichever array holds the key's bucket.
+ * Old buckets below rehash_pos have been migrated; a key whose old bucket is
+ * at or above rehash_pos still lives (and is inserted) in the old array, so
+ * every key has exactly one home at all times.
+ * ------------------------------------------------------------------------- */
+
+/**
+ * @brief Hashes a key for the chained engine. Power-of-two maps index with the low bits
+ * of the hash, so for them the hash is mixed once here and cached mixed in the pair.
+ * @param map A constant pointer to a chained hashmap.
+ * @param key The string key.
+ * @param len The length of the key.
+ * @return The hash to store in the key's pair.
+ */
+static inline uint64_t chain_hash(const hashmap* map, const char *key, size_t len)
+{
+    uint64_t h = map->hash_fn(key, len, map->seed);
+    return map->pow2 ? hm_mix64(h) : h;
+}
+
+/**
+ * @brief Maps a hash from chain_hash to a bucket index.
+ * @param map A constant pointer to a chained hashmap.
+ * @param h The hash of the key.
+ * @param size The number of buckets of the array being indexed.
+ * @return The bucket index: a mask in power-of-two mode, a division otherwise.
+ */
+static inline size_t chain_index(const hashmap* map, uint64_t h, int size)
+{
+    return map->pow2 ? (size_t)(h & (uint64_t)(size - 1)) : (size_t)(h % (uint64_t)size);
+}
+
+/**
+ * @brief Returns the bucket a key with the given hash lives in.
+ * @param map A constant pointer to a chained hashmap.
+ * @param h The hash of the key.
+ * @return Pointer to the head pointer of the key's chain.
+ */
+static inline pair** chain_bucket(const hashmap* map, uint64_t h)
+{
+    if (map->old_buckets) {
+        size_t oldIndex = chain_index(map, h, map->old_size);
+        if (oldIndex >= (size_t)map->rehash_pos) {
+            return &map->old_buckets[oldIndex];
+        }
+    }
+    return &map->buckets[chain_index(map, h, map->size)];
+}
+
+/**
+ * @brief Moves up to a given number of old buckets into the new bucket array,
+ * and drops the old array once every bucket has been moved.
+ * @param map A pointer to a chained hashmap. Does nothing if no rehash is in progress.
+ * @param steps The maximum number of old buckets to migrate.
+ */
+static void rehash_step(hashmap* map, int steps)
+{
+    if (!map->old_buckets) {
+        return;
+    }
+
+    int end = map->old_size - map->rehash_pos > steps ? map->rehash_pos + steps : map->old_size;
+    for (int i = map->rehash_pos; i < end; i++) {
+        pair* current = map->old_buckets[i];
+        // Traverse the linked list in the current old bucket
+        while (current) {
+            pair* temp = current;
+            current = current->next; // Move to the next pair in the old list before processing temp
+
+            // Insert the pair at the head of its chain in the new bucket array
+            // The cached hash spares reading the key
+            size_t newIndex = chain_index(map, temp->hash, map->size);
+            temp->next = map->buckets[newIndex];
+            map->buckets[newIndex] = temp;
+        }
+        map->old_buckets[i] = NULL;
+    }
+    map->rehash_pos = end;
+
+    if (end == map->old_size) {
+        // Free the memory allocated for the old array of buckets
+        free(map->old_buckets);
+        map->old_buckets = NULL;
+        map->old_size = 0;
+        map->rehash_pos = 0;
+    }
+}
+
+/**
+ * @brief Starts a rehash into a bucket array of the given size.
+ * Any rehash still in progress is completed first.
+ * @param map A pointer to a chained hashmap.
+ * @param newSize The number of buckets of the new array.
+ * @return HashMapStatus indicating success or failure type.
+ */
+static HashMapStatus rehash_start(hashmap* map, int newSize)
+{
+    rehash_step(map, INT_MAX);
+
+    // Allocate memory for the new array of buckets and initialize to NULL
+    pair** newBuckets = calloc(newSize, sizeof(pair*));
+    if (!newBuckets) {
+        fprintf(stderr, "Error: Failed to allocate memory for new buckets during resize.\n");
+        return HM_ERR_MALLOC_FAILED;
+    }
+
+    map->old_buckets = map->buckets;
+    map->old_size = map->size;
+    map->rehash_pos = 0;
+    map->buckets = newBuckets;
+    map->size = newSize;
+    return HM_SUCCESS;
+}
+
+/* ---------------------------------------------------------------------------
+ * Snapshot engine
+ *
+ * A map opened with hm_open_mmap points into a read-only mapping of a file
+ * written by hm_save (layout in hashmap.h). Nothing is decoded or copied at
+ * open time: a lookup hashes the key, reads two bucket offsets and scans the
+ * bucket's entries in place, so opening costs the same for any map size and
+ * pages are only read from disk when a lookup first touches them.
+ * ------------------------------------------------------------------------- */
+
+/**
+ * @brief Bytes taken by a snapshot entry with a key of the given length (NUL and padding included).
+ */
+static inline size_t snapshot_entry_size(size_t len)
+{
+    return (sizeof(hm_snapshot_entry) + len + 1 + 7) & ~(size_t)7;
+}
+
+/**
+ * @brief Hashes a key the way snapshot files do, whatever hash function the saved map used.
+ */
+static inline uint64_t snapshot_hash(uint64_t seed, const char *key, size_t len)
+{
+    return hm_mix64(hm_hash_wy(key, len, seed));
+}
+
+/**
+ * @brief Finds a key in a mapped snapshot. Offsets read from the file are bounds-checked
+ * here rather than at open time, so that a corrupt file cannot make a lookup read past the
+ * mapping and opening does not have to scan it.
+ * @param map A constant pointer to a snapshot hashmap.
+ * @param key The key bytes.
+ * @param len The length of the key.
+ * @param h The key's snapshot_hash.
+ * @return The entry holding the key, or NULL.
+ */
+static const hm_snapshot_entry* snapshot_find(const hashmap* map, const char *key, size_t len, uint64_t h)
+{
+    const hm_snapshot_header *header = (const hm_snapshot_header *)map->snapshot;
+    const uint64_t *starts = (const uint64_t *)(map->snapshot + header->buckets_offset);
+    const unsigned char *entries = map->snapshot + header->entries_offset;
+    size_t bucket = (size_t)(h & (uint64_t)(map->size - 1));
+
+    uint64_t pos = starts[bucket];
+    uint64_t end = starts[bucket + 1];
+    if (end > header->entries_len) {
+        end = header->entries_len;
+    }
+    while (pos < end && end - pos >= sizeof(hm_snapshot_entry)) {
+        const hm_snapshot_entry *entry = (const hm_snapshot_entry *)(entries + pos);
+        size_t size = snapshot_entry_size(entry->key_len);
+        if (size > end - pos) {
+            break; // Truncated entry
+        }
+        if (entry->hash == h && entry->key_len == len && memcmp(entry->key, key, len) == 0) {
+            return entry;
+        }
+        pos += size;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Rejects modifications of a snapshot map.
+ * @param map A constant pointer to a valid hashmap.
+ * @param function Name of the calling function, for the error message.
+ * @return true if the map is read-only.
+ */
+static inline bool read_only(const hashmap* map, const char *function)
+{
+    if (map->engine == HM_ENGINE_SNAPSHOT) {
+        fprintf(stderr, "Error: %s called on a read-only snapshot map.\n", function);
+        return true;
+    }
+    return false;
+}
+
+/* ---------------------------------------------------------------------------
+ * Sizing (both engines)
+ * ------------------------------------------------------------------------- */
+
+/**
+ * @brief Computes the size a map grows to when it doubles.
+ * @param map A constant pointer to the hashmap.
+ * @param newSize Output for the doubled size.
+ * @return HM_SUCCESS, or HM_ERR_SIZE_LIMIT if the doubled size does not fit in an int.
+ */
+static HashMapStatus doubled_size(const hashmap* map, int *newSize)
+{
+    // map->size is an int, so the doubled size must fit one too
+    if (__builtin_mul_overflow(map->size, 2, newSize)) {
+        fprintf(stderr, "Error: Cannot resize hashmap - size overflow.\n");
+        return HM_ERR_SIZE_LIMIT;
+    }
+    return HM_SUCCESS;
+}
+
+// One worker's share of a parallel rehash
+typedef struct rehash_range
+{
+    hashmap *map;    // The map; only read by the workers
+    int begin;       // First old bucket to migrate
+    int end;         // One past the last old bucket to migrate
+    bool disjoint;   // No other range can insert into the new buckets this range fills
+} rehash_range;
+
+/**
+ * @brief Moves the pairs of a range of old buckets into the new bucket array.
+ * When the map exactly doubles, old bucket i only feeds new buckets i and i + old_size,
+ * so disjoint ranges fill disjoint new buckets and plain stores suffice. Otherwise ranges
+ * may collide on a new bucket and pairs are pushed onto it with an atomic exchange.
+ * @param arg A pointer to a rehash_range.
+ * @return NULL.
+ */
+static void* rehash_range_run(void *arg)
+{
+    const rehash_range* range = arg;
+    hashmap* map = range->map;
+
+    for (int i = range->begin; i < range->end; i++) {
+        pair* current = map->old_buckets[i];
+        while (current) {
+            pair* temp = current;
+            current = current->next;
+
+            pair** head = &map->buckets[chain_index(map, temp->hash, map->size)];
+            if (range->disjoint) {
+                temp->next = *head;
+                *head = temp;
+            } else {
+                // Nobody walks the new chains until every worker is joined, so linking after the exchange is fine
+                temp->next = __atomic_exchange_n(head, temp, __ATOMIC_RELAXED);
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Finishes a rehash just started with rehash_start by splitting the old buckets
+ * across up to map->resize_threads threads, the calling thread being one of them.
+ * Ranges whose thread cannot be started are migrated by the calling thread.
+ * @param map A pointer to a chained hashmap with a rehash in progress and rehash_pos 0.
+ */
+static void rehash_parallel(hashmap* map)
+{
+    int threads = map->resize_threads;
+    if (threads > HM_PARALLEL_REHASH_MAX_THREADS) {
+        threads = HM_PARALLEL_REHASH_MAX_THREADS;
+    }
+    if (threads > map->old_size / HM_PARALLEL_REHASH_MIN) {
+        threads = map->old_size / HM_PARALLEL_REHASH_MIN;
+    }
+    if (threads < 2) {
+        rehash_step(map, INT_MAX);
+        return;
+    }
+
+    pthread_t workers[threads];
+    rehash_range ranges[threads];
+    bool started[threads];
+    bool disjoint = (int64_t)map->size == 2 * (int64_t)map->old_size;
+    for (int t = 0; t < threads; t++) {
+        ranges[t] = (rehash_range){
+            .map = map,
+            .begin = (int)((int64_t)map->old_size * t / threads),
+            .end = (int)((int64_t)map->old_size * (t + 1) / threads),
+            .disjoint = disjoint,
+        };
+        started[t] = t > 0 && pthread_create(&workers[t], NULL, rehash_range_run, &ranges[t]) == 0;
+    }
+    for (int t = 0; t < threads; t++) {
+        if (!started[t]) {
+            rehash_range_run(&ranges[t]);
+        }
+    }
+    for (int t = 1; t < threads; t++) {
+        if (started[t]) {
+            pthread_join(workers[t], NULL);
+        }
+    }
+
+    free(map->old_buckets);
+    map->old_buckets = NULL;
+    map->old_size = 0;
+    map->rehash_pos = 0;
+}
+
+/**
+ * @brief Synchronously moves every entry into a table of the given size.
+ * @param map A pointer to the hashmap.
+ * @param newSize The new number of buckets or slots (a power of two for swiss and pow2 maps).
+ * @return HashMapStatus indicating success or failure type.
+ */
+static HashMapStatus rehash_to(hashmap* map, int newSize)
+{
+    if (map->engine == HM_ENGINE_SWISS) {
+        return swiss_rehash(map, newSize);
+    }
+
+    // A synchronous resize is an incremental one that is driven to completion right away
+    HashMapStatus status = rehash_start(map, newSize);
+    if (status != HM_SUCCESS) {
+        return status;
+    }
+    if (map->resize_threads > 1) {
+        rehash_parallel(map);
+    } else {
+        rehash_step(map, INT_MAX);
+    }
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Computes the smallest valid size that holds a number of entries without growing.
+ * @param map A constant pointer to the hashmap.
+ * @param entries The number of entries.
+ * @param newSize Output for the size.
+ * @return HM_SUCCESS, or HM_ERR_SIZE_LIMIT if that size does not fit in an int.
+ */
+static HashMapStatus size_for(const hashmap* map, size_t entries, int *newSize)
+{
+    if (map->engine == HM_ENGINE_SWISS) {
+        int capacity = HM_GROUP_WIDTH;
+        while ((size_t)hm_growth_cap(capacity) < entries) {
+            if (capacity > INT32_MAX / 2) {
+                return HM_ERR_SIZE_LIMIT;
+            }
+            capacity <<= 1;
+        }
+        *newSize = capacity;
+        return HM_SUCCESS;
+    }
+
+    // Chained maps grow once count / size exceeds MAX_FACTOR
+    double needed = (double)entries / MAX_FACTOR;
+    if (needed >= INT32_MAX) {
+        return HM_ERR_SIZE_LIMIT;
+    }
+    int size = needed < 1 ? 1 : (int)needed + 1;
+    if (map->pow2) {
+        int capacity = 1;
+        while (capacity < size) {
+            if (capacity > INT32_MAX / 2) {
+                return HM_ERR_SIZE_LIMIT;
+            }
+            capacity <<= 1;
+        }
+        size = capacity;
+    }
+    *newSize = size;
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Grows a map so that it can hold a number of entries without any further rehash.
+ * Never shrinks the map.
+ * @param map A pointer to the hashmap.
+ * @param entries The number of entries the map must hold.
+ * @return HashMapStatus indicating success or failure type.
+ */
+static HashMapStatus presize(hashmap* map, size_t entries)
+{
+    int newSize;
+    if (size_for(map, entries, &newSize) != HM_SUCCESS) {
+        fprintf(stderr, "Error: Cannot presize hashmap - size overflow.\n");
+        return HM_ERR_SIZE_LIMIT;
+    }
+    rehash_step(map, INT_MAX);
+    if (newSize <= map->size) {
+        // Tombstones use up a swiss map's growth budget without counting as entries,
+        // so a big enough map may still need a rehash in place to take them all
+        if (map->engine == HM_ENGINE_SWISS && (size_t)map->growth_left + (size_t)map->count < entries) {
+            return swiss_rehash(map, map->size);
+        }
+        return HM_SUCCESS;
+    }
+    return rehash_to(map, newSize);
+}
+
+/**
+ * @brief Shrinks a map after a delete if its load factor fell below opts->shrink_factor.
+ * The map shrinks to a size where its load factor is about MAX_FACTOR / 2, so it has to
+ * grow or lose half of its entries again before the next resize (hysteresis).
+ * It never shrinks below the size it was created with.
+ * @param map A pointer to the hashmap.
+ */
+static void maybe_shrink(hashmap* map)
+{
+    if (map->shrink_factor <= 0 || map->old_buckets || map->size <= map->min_size ||
+        LOAD_FACTOR(map) >= map->shrink_factor) {
+        return;
+    }
+
+    int newSize;
+    if (size_for(map, (size_t)map->count * 2, &newSize) != HM_SUCCESS) {
+        return;
+    }
+    if (newSize < map->min_size) {
+        newSize = map->min_size;
+    }
+    if (newSize >= map->size) {
+        return;
+    }
+    // A failed shrink is harmless: the map simply stays at its current size
+    if (map->incremental) {
+        rehash_start(map, newSize);
+    } else {
+        rehash_to(map, newSize);
+    }
+}
+
+/**
+ * @brief Creates and initializes a new hashmap.
+ * @param size The desired number of buckets for the hashmap.
+ * @return A pointer to the newly created hashmap, or NULL if memory allocation fails.
+ */
+hashmap* c_hashmap(int size)
+{
+    return c_hashmap_ex(size, NULL);
+}
+
+/**
+ * @brief Creates and initializes a new hashmap with explicit options.
+ * @param size The desired number of buckets (chained) or slots (swiss). Rounded up to a power of two
+ *             for the swiss engine and for opts->pow2.
+ * @param opts The options, or NULL for the defaults.
+ * @return A pointer to the newly created hashmap, or NULL if the arguments are invalid or memory allocation fails.
+ */
+hashmap* c_hashmap_ex(int size, const hashmap_options *opts)
+{
+    // Validate input size
+    if (size <= 0) {
+        fprintf(stderr, "Error: Hashmap size must be positive.\n");
+        return NULL;
+    }
+    HashMapEngine engine = opts ? opts->engine : HM_ENGINE_CHAINED;
+    if (engine != HM_ENGINE_CHAINED && engine != HM_ENGINE_SWISS) {
+        fprintf(stderr, "Error: Unknown hashmap engine.\n");
+        return NULL;
+    }
+    if (opts && opts->incremental && engine != HM_ENGINE_CHAINED) {
+        fprintf(stderr, "Error: Incremental rehashing requires the chained engine.\n");
+        return NULL;
+    }
+    if (opts && (opts->resize_threads < 0 || (opts->resize_threads > 1 && engine != HM_ENGINE_CHAINED))) {
+        fprintf(stderr, "Error: Parallel resizing requires the chained engine and a non-negative thread count.\n");
+        return NULL;
+    }
+    // A map shrunk to a load factor of MAX_FACTOR / 2 must not qualify for shrinking again
+    if (opts && (opts->shrink_factor < 0 || opts->shrink_factor >= MAX_FACTOR / 2)) {
+        fprintf(stderr, "Error: Shrink factor must be in [0, MAX_FACTOR / 2).\n");
+        return NULL;
+    }
+
+    // The swiss engine always has a power-of-two capacity made of whole groups
+    bool pow2 = engine == HM_ENGINE_SWISS || (opts && opts->pow2);
+    if (pow2) {
+        if (size > (INT32_MAX >> 1) + 1) {
+            fprintf(stderr, "Error: Hashmap size is too large.\n");
+            return NULL;
+        }
+        int capacity = engine == HM_ENGINE_SWISS ? HM_GROUP_WIDTH : 1;
+        while (capacity < size) {
+            capacity <<= 1;
+        }
+        size = capacity;
+    }
+
+    // Allocate memory for the hashmap structure
+    hashmap* map = calloc(1, sizeof(hashmap));
+    if (!map) {
+        perror("Error: Failed to allocate memory for hashmap");
+        return NULL;
+    }
+    map->engine = engine;
+    map->incremental = opts && opts->incremental;
+    map->pow2 = pow2;
+    map->hash_fn = opts && opts->hash_fn ? opts->hash_fn : HM_DEFAULT_HASH;
+    map->seed = opts ? opts->seed : 0;
+    map->shrink_factor = opts ? opts->shrink_factor : 0;
+    map->min_size = size;
+    map->resize_threads = opts && opts->resize_threads > 1 ? opts->resize_threads : 1;
+    if (opts && opts->arena) {
+        map->arena = calloc(1, sizeof(hm_arena));
+        if (!map->arena) {
+            perror("Error: Failed to allocate memory for hashmap arena");
+            free(map);
+            return NULL;
+        }
+    }
+    map->count = 0; // Initialize count to 0
+
+    if (engine == HM_ENGINE_SWISS) {
+        if (swiss_alloc(size, &map->ctrl, &map->slots) != HM_SUCCESS) {
+            perror("Error: Failed to allocate memory for hashmap slots");
+            arena_destroy(map->arena);
+            free(map);
+            return NULL;
+        }
+        map->size = size;
+        map->growth_left = hm_growth_cap(size);
+        return map;
+    }
+
+    map->size = size;
+    // Allocate memory for the array of bucket pointers and initialize them to NULL
+    map->buckets = calloc(size, sizeof(pair*)); // calloc initializes memory to zero (NULL for pointers)
+    if (!map->buckets) {
+        perror("Error: Failed to allocate memory for hashmap buckets");
+        arena_destroy(map->arena);
+        free(map); // Free the hashmap structure if bucket allocation fails
+        return NULL;
+    }
+
+    return map;
+}
+
+/**
+ * @brief Chained engine implementation of put_n, for a key already hashed with chain_hash.
+ */
+static HashMapStatus chain_put(hashmap* map, const char *key, size_t len, uint64_t h, int value)
+{
+    // Find the bucket the key lives in
+    pair** bucket = chain_bucket(map, h);
+
+    // Traverse the linked list of the bucket to check if the key already exists
+    pair* current = *bucket;
+    while (current) {
+        if (pair_matches(current, key, len, h)) {
+            // Key found, update its value and return
+            current->value = value;
+            return HM_SUCCESS;
+        }
+        current = current->next;
+    }
+
+    // If the key does not exist, create a new pair
+    pair* new_pair = pair_alloc(map);
+    if (!new_pair) {
+        perror("Error: Failed to allocate memory for new pair");
+        return HM_ERR_MALLOC_FAILED;
+    }
+
+    // Copy the key, inline if it is short enough
+    if (pair_set_key(map, new_pair, key, len) != HM_SUCCESS) {
+        perror("Error: Failed to allocate memory for key string");
+        pair_free(map, new_pair);
+        return HM_ERR_MALLOC_FAILED;
+    }
+
+    new_pair->hash = h;
+    new_pair->value = value;
+    // Insert the new pair at the head of the linked list in the bucket
+    new_pair->next = *bucket;
+    *bucket = new_pair;
+    map->count++; // Increment count when a new pair is added
+
+    // If a new pair was successfully added (map->count was incremented):
+    if (LOAD_FACTOR(map) > MAX_FACTOR) {
+        int newSize;
+        HashMapStatus status = doubled_size(map, &newSize);
+        if (status == HM_SUCCESS) {
+            status = map->incremental ? rehash_start(map, newSize) : rehash_to(map, newSize);
+        }
+        if (status != HM_SUCCESS) {
+            fprintf(stderr, "Warning: Hashmap resize failed after put.\n");
+            return HM_ERR_REHASHING_FAILED;
+        }
+    }
+
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Inserts a new key-value pair into the hashmap, or updates the value if the key already exists.
+ * @param map A pointer to the hashmap.
+ * @param key The string key.
+ * @param value The integer value.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus put(hashmap* map, const char *key, int value)
+{
+    // Validate inputs
+    if (!map || !key) {
+        fprintf(stderr, "Error: Invalid hashmap or key provided to put.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    return put_n(map, key, strlen(key), value);
+}
+
+/**
+ * @brief Shared body of put_n and hm_put_hashed, once map and key are known to be valid.
+ * @param hash map->hash_fn(key, len, map->seed), unmixed.
+ * @param fn Name of the public function, for error messages.
+ */
+static HashMapStatus put_hashed(hashmap* map, const void *key, size_t len, uint64_t hash, int value, const char *fn)
+{
+    if (len >= UINT32_MAX) {
+        fprintf(stderr, "Error: Key is too long.\n");
+        return HM_ERR_SIZE_LIMIT;
+    }
+    if (read_only(map, fn)) {
+        return HM_ERR_READ_ONLY;
+    }
+    if (map->engine == HM_ENGINE_SWISS) {
+        return swiss_put(map, key, len, hm_mix64(hash), value);
+    }
+    rehash_step(map, HM_REHASH_STEP);
+    return chain_put(map, key, len, map->pow2 ? hm_mix64(hash) : hash, value);
+}
+
+/**
+ * @brief Inserts a new key-value pair, or updates the value if the key already exists.
+ * The key is any sequence of len bytes, so it may contain NUL bytes and need not be terminated.
+ * @param map A pointer to the hashmap.
+ * @param key Pointer to the key bytes.
+ * @param len The length of the key in bytes.
+ * @param value The integer value.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus put_n(hashmap* map, const void *key, size_t len, int value)
+{
+    // Validate inputs
+    if (!map || !key) {
+        fprintf(stderr, "Error: Invalid hashmap or key provided to put_n.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    return put_hashed(map, key, len, map->hash_fn(key, len, map->seed), value, "put_n");
+}
+
+/**
+ * @brief put_n for a key its caller has already hashed, e.g. to pick a shard.
+ * @param map A pointer to the hashmap.
+ * @param key Pointer to the key bytes.
+ * @param len The length of the key in bytes.
+ * @param hash map->hash_fn(key, len, map->seed), unmixed.
+ * @param value The integer value.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus hm_put_hashed(hashmap* map, const void *key, size_t len, uint64_t hash, int value)
+{
+    // Validate inputs
+    if (!map || !key) {
+        fprintf(stderr, "Error: Invalid hashmap or key provided to hm_put_hashed.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    return put_hashed(map, key, len, hash, value, "hm_put_hashed");
+}
+
+/**
+ * @brief Inserts or updates many key-value pairs at once.
+ * The map is first grown to hold count + n entries, so no rehash happens while the
+ * entries are placed; keys are then hashed and their buckets prefetched
+ * HM_PREFETCH_BATCH at a time before being inserted. A key that appears more than once
+ * ends up with its last value, as with repeated put calls. For bulk loads, an arena
+ * map (opts.arena) also avoids calling malloc for every entry.
+ * @param map A pointer to the hashmap.
+ * @param keys Array of n string keys.
+ * @param values Array of n values; values[i] is stored under keys[i].
+ * @param n The number of pairs.
+ * @return HashMapStatus indicating success or failure type. On failure, the pairs before
+ *         the failing one have been inserted.
+ */
+HashMapStatus put_many(hashmap* map, const char *const *keys, const int *values, size_t n)
+{
+    // Validate inputs
+    if (!map || (n && (!keys || !values))) {
+        fprintf(stderr, "Error: Invalid hashmap or array provided to put_many.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (!keys[i]) {
+            fprintf(stderr, "Error: Invalid key provided to put_many.\n");
+            return HM_ERR_INVALID_ARG;
+        }
+    }
+    if (read_only(map, "put_many")) {
+        return HM_ERR_READ_ONLY;
+    }
+
+    HashMapStatus status = presize(map, (size_t)map->count + n);
+    if (status != HM_SUCCESS) {
+        return status;
+    }
+
+    size_t lens[HM_PREFETCH_BATCH];
+    uint64_t hashes[HM_PREFETCH_BATCH];
+    bool swiss = map->engine == HM_ENGINE_SWISS;
+
+    for (size_t base = 0; base < n; base += HM_PREFETCH_BATCH) {
+        size_t count = n - base < HM_PREFETCH_BATCH ? n - base : HM_PREFETCH_BATCH;
+        const char *const *batch = keys + base;
+
+        // The map does not resize during the batch, so the prefetched lines stay valid
+        for (size_t i = 0; i < count; i++) {
+            lens[i] = strlen(batch[i]);
+            if (lens[i] >= UINT32_MAX) {
+                fprintf(stderr, "Error: Key is too long.\n");
+                return HM_ERR_SIZE_LIMIT;
+            }
+            if (swiss) {
+                hashes[i] = swiss_hash(map, batch[i], lens[i]);
+                __builtin_prefetch(map->ctrl + (HM_H1(hashes[i]) & (uint64_t)(map->size / HM_GROUP_WIDTH - 1)) * HM_GROUP_WIDTH);
+            } else {
+                hashes[i] = chain_hash(map, batch[i], lens[i]);
+                __builtin_prefetch(chain_bucket(map, hashes[i]));
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            status = swiss ? swiss_put(map, batch[i], lens[i], hashes[i], values[base + i])
+                           : chain_put(map, batch[i], lens[i], hashes[i], values[base + i]);
+            if (status != HM_SUCCESS) {
+                return status;
+            }
+        }
+    }
+
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Looks a key up in any engine.
+ * @param map A constant pointer to a valid hashmap.
+ * @param key Pointer to the key bytes.
+ * @param len The length of the key in bytes.
+ * @param raw map->hash_fn(key, len, map->seed); each engine derives its own hash from it.
+ * @param value Pointer to store the value in, or NULL if only presence matters.
+ * @return true if the key was found.
+ */
+static bool lookup(const hashmap* map, const char *key, size_t len, uint64_t raw, int *value)
+{
+    if (map->engine == HM_ENGINE_SNAPSHOT) {
+        // A snapshot map's hash_fn is hm_hash_wy with the file's seed, so this is snapshot_hash
+        const hm_snapshot_entry *entry = snapshot_find(map, key, len, hm_mix64(raw));
+        if (entry && value) {
+            *value = entry->value;
+        }
+        return entry != NULL;
+    }
+    if (map->engine == HM_ENGINE_SWISS) {
+        int slot = swiss_find(map, key, len, hm_mix64(raw));
+        if (slot < 0) {
+            return false;
+        }
+        if (value) {
+            *value = map->slots[slot].value;
+        }
+        return true;
+    }
+    // Lookups never move a rehash forward (only put and delete_key do), so a map shared
+    // read-only between threads is really not modified; chain_bucket checks both arrays.
+    uint64_t h = map->pow2 ? hm_mix64(raw) : raw;
+    pair* current = *chain_bucket(map, h);
+
+    // Traverse the linked list of the key's bucket
+    while (current) {
+        if (pair_matches(current, key, len, h)) {
+            if (value) {
+                *value = current->value; // Key found, store its value
+            }
+            return true;
+        }
+        current = current->next;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Retrieves the value associated with a given key from the hashmap.
+ * @param map A constant pointer to the hashmap (data won't be modified).
+ * @param key The string key to search for.
+ * @param value Pointer to store the retrieved value.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus get(const hashmap* map, const char *key, int *value)
+{
+    // Validate inputs
+    if (!map || !key || !value) {
+        fprintf(stderr, "Error: Invalid hashmap, key, or value pointer provided to get.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    size_t len = strlen(key);
+    return lookup(map, key, len, map->hash_fn(key, len, map->seed), value) ? HM_SUCCESS : HM_ERR_KEY_NOT_FOUND;
+}
+
+/**
+ * @brief Retrieves the value associated with a key of len bytes.
+ * @param map A constant pointer to the hashmap (data won't be modified).
+ * @param key Pointer to the key bytes.
+ * @param len The length of the key in bytes.
+ * @param value Pointer to store the retrieved value.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus get_n(const hashmap* map, const void *key, size_t len, int *value)
+{
+    // Validate inputs
+    if (!map || !key || !value) {
+        fprintf(stderr, "Error: Invalid hashmap, key, or value pointer provided to get_n.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    return lookup(map, key, len, map->hash_fn(key, len, map->seed), value) ? HM_SUCCESS : HM_ERR_KEY_NOT_FOUND;
+}
+
+/**
+ * @brief Checks whether a key exists in the hashmap.
+ * @param map A constant pointer to the hashmap.
+ * @param key The string key to search for.
+ * @return true if the key exists, false if it does not or the arguments are invalid.
+ */
+bool contains_key(const hashmap* map, const char *key)
+{
+    // Validate inputs
+    if (!map || !key) {
+        fprintf(stderr, "Error: Invalid hashmap or key provided to contains_key.\n");
+        return false;
+    }
+    size_t len = strlen(key);
+    return lookup(map, key, len, map->hash_fn(key, len, map->seed), NULL);
+}
+
+/**
+ * @brief Checks whether a key of len bytes exists in the hashmap.
+ * @param map A constant pointer to the hashmap.
+ * @param key Pointer to the key bytes.
+ * @param len The length of the key in bytes.
+ * @return true if the key exists, false if it does not or the arguments are invalid.
+ */
+bool contains_n(const hashmap* map, const void *key, size_t len)
+{
+    // Validate inputs
+    if (!map || !key) {
+        fprintf(stderr, "Error: Invalid hashmap or key provided to contains_n.\n");
+        return false;
+    }
+    return lookup(map, key, len, map->hash_fn(key, len, map->seed), NULL);
+}
+
+/**
+ * @brief get_n for a key its caller has already hashed, e.g. to pick a shard.
+ * @param map A constant pointer to the hashmap (data won't be modified).
+ * @param key Pointer to the key bytes.
+ * @param len The length of the key in bytes.
+ * @param hash map->hash_fn(key, len, map->seed), unmixed.
+ * @param value Pointer to store the retrieved value.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus hm_get_hashed(const hashmap* map, const void *key, size_t len, uint64_t hash, int *value)
+{
+    // Validate inputs
+    if (!map || !key || !value) {
+        fprintf(stderr, "Error: Invalid hashmap, key, or value pointer provided to hm_get_hashed.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    return lookup(map, key, len, hash, value) ? HM_SUCCESS : HM_ERR_KEY_NOT_FOUND;
+}
+
+/**
+ * @brief contains_n for a key its caller has already hashed, e.g. to pick a shard.
+ * @param map A constant pointer to the hashmap.
+ * @param key Pointer to the key bytes.
+ * @param len The length of the key in bytes.
+ * @param hash map->hash_fn(key, len, map->seed), unmixed.
+ * @return true if the key exists, false if it does not or the arguments are invalid.
+ */
+bool hm_contains_hashed(const hashmap* map, const void *key, size_t len, uint64_t hash)
+{
+    // Validate inputs
+    if (!map || !key) {
+        fprintf(stderr, "Error: Invalid hashmap or key provided to hm_contains_hashed.\n");
+        return false;
+    }
+    return lookup(map, key, len, hash, NULL);
+}
+
+/**
+ * @brief Looks up many keys at once, overlapping their cache misses.
+ * Keys are handled HM_PREFETCH_BATCH at a time in three passes: hash every key and prefetch
+ * its bucket (or control group), then prefetch the first node (or candidate slot), then
+ * resolve each key. By the last pass most of the lines it needs are already in flight.
+ * @param map A constant pointer to the hashmap (data won't be modified).
+ * @param keys Array of n string keys.
+ * @param n The number of keys.
+ * @param values Array of n ints; values[i] receives the value of keys[i] if it was found.
+ * @param statuses Array of n statuses; statuses[i] is HM_SUCCESS or HM_ERR_KEY_NOT_FOUND.
+ * @return HM_SUCCESS, or HM_ERR_INVALID_ARG if an argument (or any key) is NULL.
+ */
+HashMapStatus get_many(const hashmap* map, const char *const *keys, size_t n, int *values, HashMapStatus *statuses)
+{
+    // Validate inputs
+    if (!map || (n && (!keys || !values || !statuses))) {
+        fprintf(stderr, "Error: Invalid hashmap or array provided to get_many.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (!keys[i]) {
+            fprintf(stderr, "Error: Invalid key provided to get_many.\n");
+            return HM_ERR_INVALID_ARG;
+        }
+    }
+
+    size_t lens[HM_PREFETCH_BATCH];
+    uint64_t hashes[HM_PREFETCH_BATCH];
+    pair** buckets[HM_PREFETCH_BATCH];
+
+    for (size_t base = 0; base < n; base += HM_PREFETCH_BATCH) {
+        size_t count = n - base < HM_PREFETCH_BATCH ? n - base : HM_PREFETCH_BATCH;
+        const char *const *batch = keys + base;
+
+        if (map->engine == HM_ENGINE_SNAPSHOT) {
+            const hm_snapshot_header *header = (const hm_snapshot_header *)map->snapshot;
+            const uint64_t *starts = (const uint64_t *)(map->snapshot + header->buckets_offset);
+            for (size_t i = 0; i < count; i++) {
+                lens[i] = strlen(batch[i]);
+                hashes[i] = snapshot_hash(map->seed, batch[i], lens[i]);
+                __builtin_prefetch(&starts[hashes[i] & (uint64_t)(map->size - 1)]);
+            }
+            for (size_t i = 0; i < count; i++) {
+                const hm_snapshot_entry *entry = snapshot_find(map, batch[i], lens[i], hashes[i]);
+                statuses[base + i] = entry ? HM_SUCCESS : HM_ERR_KEY_NOT_FOUND;
+                if (entry) {
+                    values[base + i] = entry->value;
+                }
+            }
+            continue;
+        }
+
+        if (map->engine == HM_ENGINE_SWISS) {
+            int groupMask = map->size / HM_GROUP_WIDTH - 1;
+            for (size_t i = 0; i < count; i++) {
+                lens[i] = strlen(batch[i]);
+                hashes[i] = swiss_hash(map, batch[i], lens[i]);
+                __builtin_prefetch(map->ctrl + (HM_H1(hashes[i]) & (uint64_t)groupMask) * HM_GROUP_WIDTH);
+            }
+            for (size_t i = 0; i < count; i++) {
+                int group = (int)(HM_H1(hashes[i]) & (uint64_t)groupMask);
+                uint32_t match = hm_group_match(map->ctrl + (size_t)group * HM_GROUP_WIDTH, HM_H2(hashes[i]));
+                if (match) {
+                    __builtin_prefetch(&map->slots[group * HM_GROUP_WIDTH + __builtin_ctz(match)]);
+                }
+            }
+            for (size_t i = 0; i < count; i++) {
+                int slot = swiss_find(map, batch[i], lens[i], hashes[i]);
+                if (slot < 0) {
+                    statuses[base + i] = HM_ERR_KEY_NOT_FOUND;
+                } else {
+                    values[base + i] = map->slots[slot].value;
+                    statuses[base + i] = HM_SUCCESS;
+                }
+            }
+            continue;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            lens[i] = strlen(batch[i]);
+            hashes[i] = chain_hash(map, batch[i], lens[i]);
+            buckets[i] = chain_bucket(map, hashes[i]);
+            __builtin_prefetch(buckets[i]);
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (*buckets[i]) {
+                __builtin_prefetch(*buckets[i]);
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            statuses[base + i] = HM_ERR_KEY_NOT_FOUND;
+            for (pair* current = *buckets[i]; current; current = current->next) {
+                if (pair_matches(current, batch[i], lens[i], hashes[i])) {
+                    values[base + i] = current->value;
+                    statuses[base + i] = HM_SUCCESS;
+                    break;
+                }
+            }
+        }
+    }
+
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Deletes a key-value pair from the hashmap.
+ * @param map A pointer to the hashmap.
+ * @param key The string key of the pair to delete.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus delete_key(hashmap* map, const char *key)
+{
+    // Validate inputs
+    if (!map || !key) {
+        fprintf(stderr, "Error: Invalid hashmap or key provided to delete_key.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    return delete_n(map, key, strlen(key));
+}
+
+/**
+ * @brief Shared body of delete_n and hm_delete_hashed, once map and key are known to be valid.
+ * @param hash map->hash_fn(key, len, map->seed), unmixed.
+ * @param fn Name of the public function, for error messages.
+ */
+static HashMapStatus delete_hashed(hashmap* map, const void *key, size_t len, uint64_t hash, const char *fn)
+{
+    if (read_only(map, fn)) {
+        return HM_ERR_READ_ONLY;
+    }
+    if (map->engine == HM_ENGINE_SWISS) {
+        HashMapStatus status = swiss_delete(map, key, len, hm_mix64(hash));
+        if (status == HM_SUCCESS) {
+            maybe_shrink(map);
+        }
+        return status;
+    }
+    rehash_step(map, HM_REHASH_STEP);
+
+    uint64_t h = map->pow2 ? hm_mix64(hash) : hash;
+    pair** bucket = chain_bucket(map, h);
+    pair* current = *bucket;
+    pair* prev = NULL; // Pointer to the previous pair in the linked list
+
+    // Traverse the linked list to find the key to delete
+    while (current) {
+        if (pair_matches(current, key, len, h)) {
+            // Key found, remove it from the linked list
+            if (prev) {
+                prev->next = current->next; // Link previous to next, bypassing current
+            } else {
+                *bucket = current->next; // If deleting head, update bucket pointer
+            }
+
+            // Free the memory for the key string and the pair structure
+            pair_release(map, current);
+            map->count--; // Decrement count when a pair is deleted
+            maybe_shrink(map);
+            return HM_SUCCESS;
+        }
+        prev = current;      // Move prev to current
+        current = current->next; // Move current to next
+    }
+
+    return HM_ERR_KEY_NOT_FOUND;
+}
+
+/**
+ * @brief Deletes the pair whose key is the given len bytes.
+ * @param map A pointer to the hashmap.
+ * @param key Pointer to the key bytes.
+ * @param len The length of the key in bytes.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus delete_n(hashmap* map, const void *key, size_t len)
+{
+    // Validate inputs
+    if (!map || !key) {
+        fprintf(stderr, "Error: Invalid hashmap or key provided to delete_n.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    return delete_hashed(map, key, len, map->hash_fn(key, len, map->seed), "delete_n");
+}
+
+/**
+ * @brief delete_n for a key its caller has already hashed, e.g. to pick a shard.
+ * @param map A pointer to the hashmap.
+ * @param key Pointer to the key bytes.
+ * @param len The length of the key in bytes.
+ * @param hash map->hash_fn(key, len, map->seed), unmixed.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus hm_delete_hashed(hashmap* map, const void *key, size_t len, uint64_t hash)
+{
+    // Validate inputs
+    if (!map || !key) {
+        fprintf(stderr, "Error: Invalid hashmap or key provided to hm_delete_hashed.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    return delete_hashed(map, key, len, hash, "hm_delete_hashed");
+}
+
+/**
+ * @brief Resizes the hashmap by creating a new, larger array of buckets
+ * and re-hashing all existing key-value pairs into the new structure.
+ * @param map A pointer to the hashmap to be resized.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus resize(hashmap* map)
+{
+    // Validate input
+    if (!map) {
+        fprintf(stderr, "Error: Invalid hashmap provided to resize.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    if (read_only(map, "resize")) {
+        return HM_ERR_READ_ONLY;
+    }
+
+    // Any incremental rehash in progress is finished first
+    rehash_step(map, INT_MAX);
+
+    // Calculate the new size (double the current size)
+    int newSize;
+    HashMapStatus status = doubled_size(map, &newSize);
+    if (status != HM_SUCCESS) {
+        return status;
+    }
+    return rehash_to(map, newSize);
+}
+
+/**
+ * @brief Grows the hashmap so that it can hold a number of entries without resizing.
+ * Never shrinks the map.
+ * @param map A pointer to the hashmap.
+ * @param n_entries The number of entries the map must be able to hold.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus reserve(hashmap* map, size_t n_entries)
+{
+    // Validate input
+    if (!map) {
+        fprintf(stderr, "Error: Invalid hashmap provided to reserve.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    if (read_only(map, "reserve")) {
+        return HM_ERR_READ_ONLY;
+    }
+    return presize(map, n_entries);
+}
+
+/**
+ * @brief Shrinks the hashmap to the smallest size that holds its current entries
+ * without resizing. Unlike automatic shrinking, this may go below the initial size.
+ * @param map A pointer to the hashmap.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus shrink_to_fit(hashmap* map)
+{
+    // Validate input
+    if (!map) {
+        fprintf(stderr, "Error: Invalid hashmap provided to shrink_to_fit.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    if (read_only(map, "shrink_to_fit")) {
+        return HM_ERR_READ_ONLY;
+    }
+
+    // Any incremental rehash in progress is finished first
+    rehash_step(map, INT_MAX);
+
+    int newSize;
+    HashMapStatus status = size_for(map, (size_t)map->count, &newSize);
+    if (status != HM_SUCCESS || newSize >= map->size) {
+        return status;
+    }
+    return rehash_to(map, newSize);
+}
+
+/**
+ * @brief Frees every pair of a chain.
+ * @param map A pointer to the hashmap the chain belongs to.
+ * @param current The head of the chain.
+ */
+static void free_chain(hashmap* map, pair* current)
+{
+    // Traverse the linked list and free each pair
+    while (current) {
+        pair* temp = current; // Store current pair to free it
+        current = current->next; // Move to the next pair before freeing temp
+        pair_release(map, temp); // Free the pair and its key
+    }
+}
+
+/**
+ * @brief Frees all memory allocated for the hashmap.
+ * @param map A pointer to the hashmap to be deallocated.
+ */
+void d_hashmap(hashmap* map)
+{
+    if (!map) {
+        return; // Nothing to free if map is NULL
+    }
+
+    if (map->engine == HM_ENGINE_SNAPSHOT) {
+        munmap((void *)map->snapshot, map->snapshot_len);
+        free(map);
+        return;
+    }
+
+    // With an arena, only keys too long for a size class need freeing one by one
+    bool walk = !map->arena || map->arena->large_count > 0;
+
+    if (map->engine == HM_ENGINE_SWISS) {
+        for (int i = 0; walk && i < map->size; i++) {
+            if (map->ctrl[i] >= 0) {
+                key_free(map, map->slots[i].key, map->slots[i].key_len);
+            }
+        }
+        free(map->ctrl);
+        free(map->slots);
+        arena_destroy(map->arena);
+        free(map);
+        return;
+    }
+
+    // Iterate through each bucket
+    for (int i = 0; walk && i < map->size; i++) {
+        free_chain(map, map->buckets[i]);
+    }
+    // Pairs not yet migrated by an incremental rehash
+    for (int i = 0; walk && i < map->old_size; i++) {
+        free_chain(map, map->old_buckets[i]);
+    }
+
+    // Free the arrays of bucket pointers
+    free(map->buckets);
+    free(map->old_buckets);
+    // Release the arena slabs (and with them every pair and short key)
+    arena_destroy(map->arena);
+    // Free the hashmap structure itself
+    free(map);
+}
+
+/* ---------------------------------------------------------------------------
+ * Iteration
+ * ------------------------------------------------------------------------- */
+
+/**
+ * @brief Starts a walk over every entry of a map. Call hm_iter_next to reach the first entry.
+ * @param map A pointer to the hashmap, of any engine.
+ * @param it Iterator to initialize.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus hm_iter_begin(hashmap* map, hm_iter *it)
+{
+    // Validate inputs
+    if (!map || !it) {
+        fprintf(stderr, "Error: Invalid hashmap or iterator provided to hm_iter_begin.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    memset(it, 0, sizeof(hm_iter));
+    it->map = map;
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Chained engine implementation of hm_iter_next.
+ */
+static bool chain_iter_next(hm_iter *it)
+{
+    hashmap* map = it->map;
+    if (it->current) {
+        it->link = &it->current->next;
+    }
+
+    if (!it->link || !*it->link) {
+        // Find the next non-empty bucket. The bucket arrays are read in order, which the hardware
+        // prefetcher follows; the chains they point to are scattered, so fetch those ahead.
+        size_t total = (size_t)map->size + (size_t)map->old_size;
+        it->link = NULL;
+        while (it->pos < total) {
+            size_t i = it->pos++;
+            size_t ahead = i + HM_ITER_PREFETCH_DISTANCE;
+            if (ahead < total) {
+                __builtin_prefetch(ahead < (size_t)map->size ? map->buckets[ahead] : map->old_buckets[ahead - map->size]);
+            }
+            pair** bucket = i < (size_t)map->size ? &map->buckets[i] : &map->old_buckets[i - map->size];
+            if (*bucket) {
+                it->link = bucket;
+                break;
+            }
+        }
+        if (!it->link) {
+            it->current = NULL;
+            it->key = NULL;
+            return false;
+        }
+    }
+
+    it->current = *it->link;
+    __builtin_prefetch(it->current->next);
+    it->key = pair_key(it->current);
+    it->key_len = it->current->key_len;
+    it->value = it->current->value;
+    return true;
+}
+
+/**
+ * @brief Moves an iterator to the next entry.
+ * @param it An iterator started with hm_iter_begin.
+ * @return true if it now describes an entry (it->key, it->key_len, it->value), false once every
+ *         entry has been visited.
+ */
+bool hm_iter_next(hm_iter *it)
+{
+    if (!it || !it->map) {
+        return false;
+    }
+    hashmap* map = it->map;
+
+    if (map->engine == HM_ENGINE_SNAPSHOT) {
+        const hm_snapshot_header *header = (const hm_snapshot_header *)map->snapshot;
+        const unsigned char *entries = map->snapshot + header->entries_offset;
+        if (header->entries_len - it->pos >= sizeof(hm_snapshot_entry)) {
+            const hm_snapshot_entry *entry = (const hm_snapshot_entry *)(entries + it->pos);
+            size_t size = snapshot_entry_size(entry->key_len);
+            if (size <= header->entries_len - it->pos) {
+                it->pos += size;
+                it->key = entry->key;
+                it->key_len = entry->key_len;
+                it->value = entry->value;
+                return true;
+            }
+        }
+        it->key = NULL; // Done, or stopped at a truncated entry
+        return false;
+    }
+
+    if (map->engine == HM_ENGINE_SWISS) {
+        while (it->pos < (size_t)map->size) {
+            size_t i = it->pos++;
+            if (i + HM_ITER_PREFETCH_DISTANCE < (size_t)map->size && map->ctrl[i + HM_ITER_PREFETCH_DISTANCE] >= 0) {
+                __builtin_prefetch(map->slots[i + HM_ITER_PREFETCH_DISTANCE].key);
+            }
+            if (map->ctrl[i] >= 0) {
+                it->key = map->slots[i].key;
+                it->key_len = map->slots[i].key_len;
+                it->value = map->slots[i].value;
+                return true;
+            }
+        }
+        it->key = NULL;
+        return false;
+    }
+
+    return chain_iter_next(it);
+}
+
+/**
+ * @brief Deletes the entry an iterator is on, without disturbing the walk: the next call to
+ * hm_iter_next continues with the entry after it. Unlike delete_key, this never steps an
+ * incremental rehash or shrinks the map, since either would reorder the entries being walked;
+ * call shrink_to_fit after a large purge.
+ * @param it An iterator on an entry (hm_iter_next returned true and it was not erased since).
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus hm_iter_erase(hm_iter *it)
+{
+    // Validate inputs
+    if (!it || !it->map || !it->key) {
+        fprintf(stderr, "Error: Iterator provided to hm_iter_erase is not on an entry.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    hashmap* map = it->map;
+    if (read_only(map, "hm_iter_erase")) {
+        return HM_ERR_READ_ONLY;
+    }
+
+    if (map->engine == HM_ENGINE_SWISS) {
+        swiss_erase_slot(map, (int)it->pos - 1);
+    } else {
+        // The link now leads to the next pair of the chain, where hm_iter_next resumes
+        *it->link = it->current->next;
+        pair_release(map, it->current);
+        map->count--;
+        it->current = NULL;
+    }
+    it->key = NULL;
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Prints every key-value pair of a map, one per line, in iteration order.
+ * @param map A constant pointer to the hashmap.
+ */
+void p_hashmap(const hashmap* map)
+{
+    if (!map) {
+        printf("(null)\n");
+        return;
+    }
+    printf("hashmap: %d pairs in %d %s\n", map->count, map->size, map->engine == HM_ENGINE_SWISS ? "slots" : "buckets");
+
+    hm_iter it;
+    hm_iter_begin((hashmap *)map, &it); // Only read
+    while (hm_iter_next(&it)) {
+        printf("  %.*s: %d\n", (int)it.key_len, it.key, it.value);
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * Statistics
+ * ------------------------------------------------------------------------- */
+
+/**
+ * @brief Adds one chain (or probe) length to the histogram, maximum and probe sums of hm_stats.
+ */
+static inline void stats_add_chain(hashmap_stats *out, int len)
+{
+    out->chain_hist[len < HM_STATS_HISTOGRAM ? len : HM_STATS_HISTOGRAM - 1]++;
+    if (len > out->max_chain) {
+        out->max_chain = len;
+    }
+}
+
+/**
+ * @brief Swiss engine implementation of hm_stats. Each full slot's probe length is found by
+ * replaying its probe sequence from the home group, using the cached hash.
+ */
+static void swiss_stats(const hashmap* map, hashmap_stats *out)
+{
+    int groups = map->size / HM_GROUP_WIDTH;
+    int groupMask = groups - 1;
+    uint64_t hitProbes = 0;
+    uint64_t missProbes = 0;
+    size_t keyBytes = 0;
+
+    for (int g = 0; g < groups; g++) {
+        const int8_t *ctrl = map->ctrl + (size_t)g * HM_GROUP_WIDTH;
+        uint32_t full = ~hm_group_match_free(ctrl) & ((1u << HM_GROUP_WIDTH) - 1);
+        if (!full) {
+            out->empty_buckets++;
+        }
+        for (; full; full &= full - 1) {
+            const hm_slot *slot = &map->slots[(size_t)g * HM_GROUP_WIDTH + __builtin_ctz(full)];
+            int group = (int)(HM_H1(slot->hash) & (uint64_t)groupMask);
+            int probes = 1;
+            for (int step = 1; group != g; step++, probes++) {
+                group = (group + step) & groupMask;
+            }
+            stats_add_chain(out, probes);
+            hitProbes += (uint64_t)probes;
+            if (!map->arena || slot->key_len + 1 > HM_ARENA_CLASS_SIZE * HM_ARENA_CLASSES) {
+                keyBytes += slot->key_len + 1; // Separately malloc'd key
+            }
+        }
+
+        // A miss starting here stops at the first group with an EMPTY slot
+        int group = g;
+        int probes = 1;
+        for (int step = 1; !hm_group_match(map->ctrl + (size_t)group * HM_GROUP_WIDTH, HM_CTRL_EMPTY) && probes < groups; step++, probes++) {
+            group = (group + step) & groupMask;
+        }
+        missProbes += (uint64_t)probes;
+    }
+
+    out->buckets = groups;
+    out->avg_probes_hit = map->count ? (double)hitProbes / map->count : 0;
+    out->avg_probes_miss = (double)missProbes / groups;
+    out->bytes = sizeof(hashmap) + (size_t)map->size * (sizeof(int8_t) + sizeof(hm_slot)) + keyBytes;
+}
+
+/**
+ * @brief Snapshot engine implementation of hm_stats, from the bucket offsets and record headers.
+ */
+static void snapshot_stats(const hashmap* map, hashmap_stats *out)
+{
+    const hm_snapshot_header *header = (const hm_snapshot_header *)map->snapshot;
+    const uint64_t *starts = (const uint64_t *)(map->snapshot + header->buckets_offset);
+    const unsigned char *entries = map->snapshot + header->entries_offset;
+    uint64_t hitProbes = 0;
+    uint64_t missProbes = 0;
+
+    for (int b = 0; b < map->size; b++) {
+        uint64_t end = starts[b + 1] < header->entries_len ? starts[b + 1] : header->entries_len;
+        int len = 0;
+        for (uint64_t pos = starts[b]; pos < end && end - pos >= sizeof(hm_snapshot_entry); len++) {
+            pos += snapshot_entry_size(((const hm_snapshot_entry *)(entries + pos))->key_len);
+        }
+        if (len == 0) {
+            out->empty_buckets++;
+        }
+        stats_add_chain(out, len);
+        hitProbes += (uint64_t)len * (uint64_t)(len + 1) / 2;
+        missProbes += (uint64_t)len;
+    }
+
+    out->buckets = map->size;
+    out->avg_probes_hit = map->count ? (double)hitProbes / map->count : 0;
+    out->avg_probes_miss = (double)missProbes / map->size;
+    out->bytes = map->snapshot_len;
+}
+
+/**
+ * @brief Computes occupancy and chain-length statistics of a map. It makes one pass over the
+ * buckets and pairs (the cached hashes stand in for the keys, which are never read) and
+ * allocates nothing, so it can be called periodically, e.g. from a metrics thread holding
+ * whatever lock guards the map.
+ * @param map A constant pointer to the hashmap, of any engine.
+ * @param out Pointer to store the statistics.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus hm_stats(const hashmap* map, hashmap_stats *out)
+{
+    // Validate inputs
+    if (!map || !out) {
+        fprintf(stderr, "Error: Invalid hashmap or stats pointer provided to hm_stats.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    memset(out, 0, sizeof(hashmap_stats));
+    out->count = map->count;
+    out->load_factor = LOAD_FACTOR(map);
+
+    if (map->engine == HM_ENGINE_SWISS) {
+        swiss_stats(map, out);
+    } else if (map->engine == HM_ENGINE_SNAPSHOT) {
+        snapshot_stats(map, out);
+    } else {
+        // A hit on the i-th pair of a chain compares i pairs; a miss compares the whole chain
+        uint64_t hitProbes = 0;
+        uint64_t missProbes = 0;
+        size_t keyBytes = 0;
+        int total = map->size + map->old_size;
+        for (int i = 0; i < total; i++) {
+            int len = 0;
+            for (pair* p = i < map->size ? map->buckets[i] : map->old_buckets[i - map->size]; p; p = p->next, len++) {
+                if (p->key_len >= HM_INLINE_KEY_SIZE && (!map->arena || p->key_len + 1 > HM_ARENA_CLASS_SIZE * HM_ARENA_CLASSES)) {
+                    keyBytes += p->key_len + 1; // Separately malloc'd key
+                }
+            }
+            if (len == 0) {
+                out->empty_buckets++;
+            }
+            stats_add_chain(out, len);
+            hitProbes += (uint64_t)len * (uint64_t)(len + 1) / 2;
+            missProbes += (uint64_t)len;
+        }
+        out->buckets = total;
+        out->avg_probes_hit = map->count ? (double)hitProbes / map->count : 0;
+        out->avg_probes_miss = total ? (double)missProbes / total : 0;
+        out->bytes = sizeof(hashmap) + (size_t)total * sizeof(pair*) + keyBytes;
+        if (!map->arena) {
+            out->bytes += (size_t)map->count * sizeof(pair);
+        }
+    }
+
+    if (map->arena) {
+        // Pairs and short keys live in the slabs, in use or on a freelist
+        out->bytes += sizeof(hm_arena);
+        for (const hm_slab* slab = map->arena->slabs; slab; slab = slab->next) {
+            out->bytes += sizeof(hm_slab) + slab->cap;
+        }
+    }
+    out->empty_ratio = out->buckets ? (double)out->empty_buckets / out->buckets : 0;
+    return HM_SUCCESS;
+}
+
+/* ---------------------------------------------------------------------------
+ * Snapshot files
+ * ------------------------------------------------------------------------- */
+
+// Callback of for_each_entry; returns false to stop the walk
+typedef bool (*entry_visitor)(void *ctx, const char *key, size_t len, int value);
+
+/**
+ * @brief Calls a visitor for every key-value pair of a map of any engine.
+ * @param map A constant pointer to the hashmap.
+ * @param visit The visitor.
+ * @param ctx Passed to the visitor.
+ * @return false if the visitor stopped the walk.
+ */
+static bool for_each_entry(const hashmap* map, entry_visitor visit, void *ctx)
+{
+    hm_iter it;
+    hm_iter_begin((hashmap *)map, &it); // Only read
+    while (hm_iter_next(&it)) {
+        if (!visit(ctx, it.key, it.key_len, it.value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// State shared by the visitors of hm_save
+typedef struct snapshot_writer
+{
+    unsigned char *file;     // The mapped output file
+    hm_snapshot_header *header;
+    uint64_t *starts;        // bucket_starts in the file
+    uint64_t entries_len;    // Pass 1: bytes of entries
+} snapshot_writer;
+
+static bool snapshot_measure(void *ctx, const char *key, size_t len, int value)
+{
+    (void)key;
+    (void)value;
+    ((snapshot_writer *)ctx)->entries_len += snapshot_entry_size(len);
+    return true;
+}
+
+static bool snapshot_count(void *ctx, const char *key, size_t len, int value)
+{
+    (void)value;
+    snapshot_writer *w = ctx;
+    uint64_t h = snapshot_hash(w->header->seed, key, len);
+    w->starts[(h & (w->header->bucket_count - 1)) + 1] += snapshot_entry_size(len);
+    return true;
+}
+
+static bool snapshot_write(void *ctx, const char *key, size_t len, int value)
+{
+    snapshot_writer *w = ctx;
+    uint64_t h = snapshot_hash(w->header->seed, key, len);
+    uint64_t *cursor = &w->starts[h & (w->header->bucket_count - 1)];
+    hm_snapshot_entry *entry = (hm_snapshot_entry *)(w->file + w->header->entries_offset + *cursor);
+    entry->hash = h;
+    entry->key_len = (uint32_t)len;
+    entry->value = value;
+    memcpy(entry->key, key, len); // The NUL and padding are already zero
+    *cursor += snapshot_entry_size(len);
+    return true;
+}
+
+/**
+ * @brief Flushes the directory holding path, so a rename into it survives a crash.
+ * @param path The file whose parent directory is synced.
+ * @return true on success.
+ */
+static bool sync_parent_dir(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    size_t dirLen = slash ? (size_t)(slash - path) : 0;
+    char *dir = malloc(dirLen + 2);
+    if (!dir) {
+        perror("Error: Failed to allocate memory for snapshot directory");
+        return false;
+    }
+    if (!slash) {
+        strcpy(dir, ".");
+    } else if (dirLen == 0) {
+        strcpy(dir, "/");
+    } else {
+        memcpy(dir, path, dirLen);
+        dir[dirLen] = '\0';
+    }
+
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    free(dir);
+    if (fd < 0) {
+        perror("Error: Failed to open snapshot directory");
+        return false;
+    }
+    bool synced = fsync(fd) == 0;
+    if (!synced) {
+        perror("Error: Failed to sync snapshot directory");
+    }
+    close(fd);
+    return synced;
+}
+
+/**
+ * @brief Writes a map to a snapshot file that hm_open_mmap can serve lookups from in place.
+ * The file is written under a temporary name, synced, renamed over path once complete and
+ * the directory synced, so readers never see a partial snapshot and a crash leaves either
+ * the old or the new one. Any map can be saved, including a snapshot map.
+ * @param map A constant pointer to the hashmap.
+ * @param path The file to write.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus hm_save(const hashmap* map, const char *path)
+{
+    // Validate inputs
+    if (!map || !path) {
+        fprintf(stderr, "Error: Invalid hashmap or path provided to hm_save.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+
+    // About one entry per bucket keeps every scan short
+    uint64_t bucketCount = 1;
+    while (bucketCount < (uint64_t)map->count && bucketCount < HM_SNAPSHOT_MAX_BUCKETS) {
+        bucketCount <<= 1;
+    }
+    snapshot_writer w = { 0 };
+    for_each_entry(map, snapshot_measure, &w);
+    uint64_t bucketsOffset = sizeof(hm_snapshot_header);
+    uint64_t entriesOffset = bucketsOffset + (bucketCount + 1) * sizeof(uint64_t);
+    uint64_t fileLen = entriesOffset + w.entries_len;
+    if (fileLen > SIZE_MAX || fileLen > (uint64_t)INT64_MAX) {
+        fprintf(stderr, "Error: Snapshot is too large.\n");
+        return HM_ERR_SIZE_LIMIT;
+    }
+
+    size_t pathLen = strlen(path);
+    char *tmpPath = malloc(pathLen + sizeof(".tmp"));
+    if (!tmpPath) {
+        perror("Error: Failed to allocate memory for snapshot path");
+        return HM_ERR_MALLOC_FAILED;
+    }
+    memcpy(tmpPath, path, pathLen);
+    memcpy(tmpPath + pathLen, ".tmp", sizeof(".tmp"));
+
+    int fd = open(tmpPath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Error: Failed to create snapshot file");
+        free(tmpPath);
+        return HM_ERR_IO;
+    }
+    // A fresh file reads as zeros, which every bucket counter and padding byte relies on. Its
+    // blocks are allocated up front: a store into a sparse mapping on a full disk raises SIGBUS
+    // rather than returning an error.
+    int err = posix_fallocate(fd, 0, (off_t)fileLen);
+    if (err != 0) {
+        errno = err;
+        perror("Error: Failed to allocate space for snapshot file");
+        close(fd);
+        unlink(tmpPath);
+        free(tmpPath);
+        return HM_ERR_IO;
+    }
+    void *file = mmap(NULL, (size_t)fileLen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (file == MAP_FAILED) {
+        perror("Error: Failed to map snapshot file for writing");
+        close(fd);
+        unlink(tmpPath);
+        free(tmpPath);
+        return HM_ERR_IO;
+    }
+
+    w.file = file;
+    w.header = file;
+    w.starts = (uint64_t *)(w.file + bucketsOffset);
+    memcpy(w.header->magic, HM_SNAPSHOT_MAGIC, sizeof(w.header->magic));
+    w.header->version = HM_SNAPSHOT_VERSION;
+    w.header->byte_order = 0x01020304;
+    w.header->seed = map->seed;
+    w.header->count = (uint64_t)map->count;
+    w.header->bucket_count = bucketCount;
+    w.header->buckets_offset = bucketsOffset;
+    w.header->entries_offset = entriesOffset;
+    w.header->entries_len = w.entries_len;
+
+    // Size every bucket, turn the sizes into start offsets, then place the entries using the
+    // starts as cursors; afterwards starts[b] holds the end of bucket b, so shift them back
+    for_each_entry(map, snapshot_count, &w);
+    for (uint64_t b = 1; b <= bucketCount; b++) {
+        w.starts[b] += w.starts[b - 1];
+    }
+    for_each_entry(map, snapshot_write, &w);
+    memmove(w.starts + 1, w.starts, bucketCount * sizeof(uint64_t));
+    w.starts[0] = 0;
+
+    HashMapStatus status = HM_SUCCESS;
+    // msync reports write-back errors of the mapping, which munmap would drop
+    if (msync(file, (size_t)fileLen, MS_SYNC) != 0) {
+        perror("Error: Failed to write snapshot file");
+        status = HM_ERR_IO;
+    }
+    if (munmap(file, (size_t)fileLen) != 0 || (status == HM_SUCCESS && fsync(fd) != 0)) {
+        perror("Error: Failed to write snapshot file");
+        status = HM_ERR_IO;
+    }
+    if (close(fd) != 0 && status == HM_SUCCESS) {
+        perror("Error: Failed to close snapshot file");
+        status = HM_ERR_IO;
+    }
+    if (status == HM_SUCCESS && rename(tmpPath, path) != 0) {
+        perror("Error: Failed to move snapshot file into place");
+        status = HM_ERR_IO;
+    }
+    if (status != HM_SUCCESS) {
+        unlink(tmpPath);
+        free(tmpPath);
+        return status;
+    }
+    free(tmpPath);
+    // The new file is already in place, but the rename is only durable once its directory is
+    return sync_parent_dir(path) ? HM_SUCCESS : HM_ERR_IO;
+}
+
+/**
+ * @brief Maps a snapshot file written by hm_save and returns it as a read-only hashmap.
+ * Only the header is checked, so opening takes the same time for any size of map;
+ * get, get_n, get_many, contains_key and contains_n read the mapping in place, and
+ * functions that would modify the map return HM_ERR_READ_ONLY. d_hashmap unmaps it.
+ * @param path The snapshot file.
+ * @return The map, or NULL if the file cannot be mapped or is not a valid snapshot.
+ */
+hashmap* hm_open_mmap(const char *path)
+{
+    // Validate input
+    if (!path) {
+        fprintf(stderr, "Error: Invalid path provided to hm_open_mmap.\n");
+        return NULL;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Error: Failed to open snapshot file");
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(hm_snapshot_header) || (uint64_t)st.st_size > SIZE_MAX) {
+        fprintf(stderr, "Error: Snapshot file is missing or too short.\n");
+        close(fd);
+        return NULL;
+    }
+    size_t fileLen = (size_t)st.st_size;
+    void *file = mmap(NULL, fileLen, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file open
+    if (file == MAP_FAILED) {
+        perror("Error: Failed to map snapshot file");
+        return NULL;
+    }
+
+    const hm_snapshot_header *header = file;
+    bool valid = memcmp(header->magic, HM_SNAPSHOT_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->version == HM_SNAPSHOT_VERSION &&
+                 header->byte_order == 0x01020304 &&
+                 header->bucket_count >= 1 && header->bucket_count <= HM_SNAPSHOT_MAX_BUCKETS &&
+                 (header->bucket_count & (header->bucket_count - 1)) == 0 &&
+                 header->count <= INT_MAX &&
+                 header->buckets_offset % 8 == 0 && header->entries_offset % 8 == 0 &&
+                 header->buckets_offset <= fileLen &&
+                 (fileLen - header->buckets_offset) / sizeof(uint64_t) > header->bucket_count &&
+                 header->entries_offset <= fileLen &&
+                 header->entries_len <= fileLen - header->entries_offset;
+    if (!valid) {
+        fprintf(stderr, "Error: %s is not a valid snapshot file.\n", path);
+        munmap(file, fileLen);
+        return NULL;
+    }
+
+    hashmap* map = calloc(1, sizeof(hashmap));
+    if (!map) {
+        perror("Error: Failed to allocate memory for hashmap");
+        munmap(file, fileLen);
+        return NULL;
+    }
+    map->engine = HM_ENGINE_SNAPSHOT;
+    map->size = (int)header->bucket_count;
+    map->count = (int)header->count;
+    map->hash_fn = hm_hash_wy;
+    map->seed = header->seed;
+    map->min_size = map->size;
+    map->resize_threads = 1;
+    map->snapshot = file;
+    map->snapshot_len = fileLen;
+    return map;
+}
+
+/* ---------------------------------------------------------------------------
+ * Streams
+ * ------------------------------------------------------------------------- */
+
+// State of hm_stream_write: the batch being filled, written out in one callback call
+typedef struct stream_writer
+{
+    hm_stream_write_fn write_fn;
+    void *ctx;
+    unsigned char *buf;      // hm_stream_batch followed by the entries
+    size_t cap;              // Bytes allocated for buf
+    size_t used;             // Bytes of buf filled, batch header included
+    uint32_t entries;        // Entries in the batch
+    HashMapStatus status;    // First error, which stops the walk
+} stream_writer;
+
+/**
+ * @brief Hands the filled batch to the write callback and starts a new one.
+ */
+static bool stream_flush(stream_writer *w)
+{
+    hm_stream_batch batch = { w->entries, (uint32_t)(w->used - sizeof(hm_stream_batch)) };
+    memcpy(w->buf, &batch, sizeof(batch));
+    if (!w->write_fn(w->ctx, w->buf, w->used)) {
+        fprintf(stderr, "Error: Stream write callback failed.\n");
+        w->status = HM_ERR_IO;
+        return false;
+    }
+    w->used = sizeof(hm_stream_batch);
+    w->entries = 0;
+    return true;
+}
+
+static bool stream_append(void *ctx, const char *key, size_t len, int value)
+{
+    stream_writer *w = ctx;
+    size_t size = sizeof(hm_stream_entry) + len;
+    if (size > UINT32_MAX - sizeof(hm_stream_batch)) {
+        fprintf(stderr, "Error: Key is too long for a stream batch.\n");
+        w->status = HM_ERR_SIZE_LIMIT;
+        return false;
+    }
+    if ((w->entries == HM_STREAM_BATCH_ENTRIES || w->used + size > w->cap) && w->entries && !stream_flush(w)) {
+        return false;
+    }
+    if (w->used + size > w->cap) {
+        // A single entry larger than a batch gets a batch of its own
+        unsigned char *buf = realloc(w->buf, w->used + size);
+        if (!buf) {
+            perror("Error: Failed to allocate memory for stream batch");
+            w->status = HM_ERR_MALLOC_FAILED;
+            return false;
+        }
+        w->buf = buf;
+        w->cap = w->used + size;
+    }
+
+    hm_stream_entry entry = { (uint32_t)len, value };
+    memcpy(w->buf + w->used, &entry, sizeof(entry));
+    memcpy(w->buf + w->used + sizeof(entry), key, len);
+    w->used += size;
+    w->entries++;
+
+    if (w->cap > sizeof(hm_stream_batch) + HM_STREAM_BATCH_BYTES) {
+        // Send the oversized batch now and go back to the usual buffer, rather than holding
+        // on to one the size of the largest key for the rest of the walk
+        if (!stream_flush(w)) {
+            return false;
+        }
+        unsigned char *buf = realloc(w->buf, sizeof(hm_stream_batch) + HM_STREAM_BATCH_BYTES);
+        if (buf) {
+            w->buf = buf;
+            w->cap = sizeof(hm_stream_batch) + HM_STREAM_BATCH_BYTES;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Writes every pair of a map as a stream (format in hashmap.h). Pairs are gathered into
+ * batches, so the callback is called once per batch rather than once per pair.
+ * @param map A constant pointer to the hashmap, of any engine.
+ * @param write_fn Callback consuming the stream, e.g. hm_stream_file_write.
+ * @param ctx Passed to write_fn.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus hm_stream_write(const hashmap* map, hm_stream_write_fn write_fn, void *ctx)
+{
+    // Validate inputs
+    if (!map || !write_fn) {
+        fprintf(stderr, "Error: Invalid hashmap or callback provided to hm_stream_write.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+
+    hm_stream_header header = { .version = HM_STREAM_VERSION, .byte_order = 0x01020304, .count = (uint64_t)map->count };
+    memcpy(header.magic, HM_STREAM_MAGIC, sizeof(header.magic));
+    if (!write_fn(ctx, &header, sizeof(header))) {
+        fprintf(stderr, "Error: Stream write callback failed.\n");
+        return HM_ERR_IO;
+    }
+
+    stream_writer w = { .write_fn = write_fn, .ctx = ctx, .cap = sizeof(hm_stream_batch) + HM_STREAM_BATCH_BYTES,
+                        .used = sizeof(hm_stream_batch), .status = HM_SUCCESS };
+    w.buf = malloc(w.cap);
+    if (!w.buf) {
+        perror("Error: Failed to allocate memory for stream batch");
+        return HM_ERR_MALLOC_FAILED;
+    }
+    // Flush the last entries, then an empty batch as the end marker
+    if (for_each_entry(map, stream_append, &w) && (!w.entries || stream_flush(&w))) {
+        stream_flush(&w);
+    }
+    free(w.buf);
+    return w.status;
+}
+
+/**
+ * @brief Calls a read callback until len bytes have been read.
+ * @return false if the input ended first.
+ */
+static bool stream_read_full(hm_stream_read_fn read_fn, void *ctx, void *buf, size_t len)
+{
+    for (size_t done = 0; done < len; ) {
+        size_t n = read_fn(ctx, (unsigned char *)buf + done, len - done);
+        if (n == 0) {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+/**
+ * @brief Loads a stream written by hm_stream_write into a map, inserting each pair with put_n
+ * (so existing keys are updated). The map is first grown with reserve to hold the count from
+ * the stream header, up to HM_STREAM_MAX_PRESIZE entries, so loading a stream of that size
+ * never resizes; the header is untrusted input, so larger streams grow the map as they arrive.
+ * @param map A pointer to a writable hashmap, typically empty and created with the options wanted.
+ * @param read_fn Callback producing the stream, e.g. hm_stream_file_read.
+ * @param ctx Passed to read_fn.
+ * @return HashMapStatus indicating success or failure type; HM_ERR_IO if the stream is malformed
+ *         or ends early, in which case the pairs read so far remain in the map.
+ */
+HashMapStatus hm_stream_read(hashmap* map, hm_stream_read_fn read_fn, void *ctx)
+{
+    // Validate inputs
+    if (!map || !read_fn) {
+        fprintf(stderr, "Error: Invalid hashmap or callback provided to hm_stream_read.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    if (read_only(map, "hm_stream_read")) {
+        return HM_ERR_READ_ONLY;
+    }
+
+    hm_stream_header header;
+    if (!stream_read_full(read_fn, ctx, &header, sizeof(header)) ||
+        memcmp(header.magic, HM_STREAM_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != HM_STREAM_VERSION || header.byte_order != 0x01020304) {
+        fprintf(stderr, "Error: Input is not a valid hashmap stream.\n");
+        return HM_ERR_IO;
+    }
+    if (header.count > INT_MAX) {
+        fprintf(stderr, "Error: Stream holds too many entries for a hashmap.\n");
+        return HM_ERR_SIZE_LIMIT;
+    }
+    size_t presize = header.count < HM_STREAM_MAX_PRESIZE ? (size_t)header.count : HM_STREAM_MAX_PRESIZE;
+    HashMapStatus status = reserve(map, (size_t)map->count + presize);
+    if (status != HM_SUCCESS) {
+        return status;
+    }
+
+    size_t cap = HM_STREAM_BATCH_BYTES;
+    unsigned char *buf = malloc(cap);
+    if (!buf) {
+        perror("Error: Failed to allocate memory for stream batch");
+        return HM_ERR_MALLOC_FAILED;
+    }
+    uint64_t read = 0;
+    for (;;) {
+        hm_stream_batch batch;
+        if (!stream_read_full(read_fn, ctx, &batch, sizeof(batch))) {
+            status = HM_ERR_IO;
+            break;
+        }
+        if (batch.entries == 0) {
+            status = read == header.count && batch.bytes == 0 ? HM_SUCCESS : HM_ERR_IO;
+            break;
+        }
+        if (batch.bytes > cap) {
+            unsigned char *bigger = realloc(buf, batch.bytes);
+            if (!bigger) {
+                perror("Error: Failed to allocate memory for stream batch");
+                status = HM_ERR_MALLOC_FAILED;
+                break;
+            }
+            buf = bigger;
+            cap = batch.bytes;
+        }
+        if (!stream_read_full(read_fn, ctx, buf, batch.bytes)) {
+            status = HM_ERR_IO;
+            break;
+        }
+
+        // Walk the entries, checking each one lies inside the batch
+        size_t pos = 0;
+        for (uint32_t i = 0; i < batch.entries && status == HM_SUCCESS; i++) {
+            hm_stream_entry entry;
+            if (batch.bytes - pos < sizeof(entry)) {
+                status = HM_ERR_IO;
+                break;
+            }
+            memcpy(&entry, buf + pos, sizeof(entry));
+            pos += sizeof(entry);
+            if (batch.bytes - pos < entry.key_len) {
+                status = HM_ERR_IO;
+                break;
+            }
+            status = put_n(map, buf + pos, entry.key_len, entry.value);
+            pos += entry.key_len;
+        }
+        if (status == HM_SUCCESS && pos != batch.bytes) {
+            status = HM_ERR_IO;
+        }
+        if (status != HM_SUCCESS) {
+            break;
+        }
+        read += batch.entries;
+        if (cap > HM_STREAM_BATCH_BYTES) {
+            // Same as the writer: an oversized batch does not keep its buffer
+            unsigned char *smaller = realloc(buf, HM_STREAM_BATCH_BYTES);
+            if (smaller) {
+                buf = smaller;
+                cap = HM_STREAM_BATCH_BYTES;
+            }
+        }
+    }
+    free(buf);
+    if (status == HM_ERR_IO) {
+        fprintf(stderr, "Error: Hashmap stream is truncated or corrupt.\n");
+    }
+    return status;
+}
+
+/**
+ * @brief hm_stream_write_fn writing to the FILE* passed as ctx (a file, a pipe from popen, ...).
+ */
+bool hm_stream_file_write(void *ctx, const void *data, size_t len)
+{
+    return fwrite(data, 1, len, (FILE *)ctx) == len;
+}
+
+/**
+ * @brief hm_stream_read_fn reading from the FILE* passed as ctx.
+ */
+size_t hm_stream_file_read(void *ctx, void *buf, size_t len)
+{
+    return fread(buf, 1, len, (FILE *)ctx);
+}
@@ -1,56 +1,398 @@
-#pragma once
-
-#include <stdio.h>
-#include <string.h>
-#include <stdlib.h>
-#include <stdbool.h>
-#include <stdint.h>
-
-// A macro for calculating the hash index
-#define HASH_INDEX(key, size) (hash(key) % (unsigned long)(size))
-// A macro for calculating the load factor
-#define LOAD_FACTOR(map) ((float) map -> count / map -> size)
-// A macro for our max factor (might lower it later)
-#define MAX_FACTOR 0.75
-
-// Structure to represent a key-value pair in the hashmap.
-// It includes a pointer to the next pair to handle collisions using separate chaining.
-typedef struct pair
-{
-    char *key;
-    int value;
-    struct pair *next; // Pointer to the next pair in case of a collision (linked list)
-} pair;
-
-// Structure to represent the hashmap itself.
-// It contains the number of buckets and an array of pointers to pairs (the buckets).
-typedef struct hashmap
-{
-    int size;          // Number of buckets in the hashmap
-    pair **buckets;    // Array of pointers to pairs (each bucket is a linked list)
-    int count;         // Number of key-value pairs
-} hashmap;
-
-// Enum for function return status
-typedef enum HashMapStatus{
-    HM_SUCCESS = 0,
-    HM_ERR_MALLOC_FAILED,
-    HM_ERR_KEY_NOT_FOUND,
-    HM_ERR_INVALID_ARG,
-    HM_ERR_REHASHING_FAILED,
-    HM_ERR_CLEAR_FAILED,
-    HM_ERR_SIZE_LIMIT,
-} HashMapStatus;
-
-// Function declarations
-unsigned long hash(const char* string);                    // Hashes a string to an unsigned long
-hashmap* c_hashmap(int size);                              // Creates and initializes a new hashmap
-HashMapStatus put(hashmap* map, const char *key, int value); // Inserts or updates a key-value pair
-HashMapStatus get(const hashmap* map, const char *key, int *value); // Retrieves the value associated with a key
-HashMapStatus delete_key(hashmap* map, const char *key);   // Deletes a key-value pair
-HashMapStatus resize(hashmap* map);                        // Dynamic resizing
-// TODO: 
-bool contains_key(const hashmap* map, const char *key);   // Checks if a key exists in the hashmap
-HashMapStatus clear(hashmap* map);                         // Clears all key-value pairs from the hashmap
-void p_hashmap(const hashmap* map);                   // Prints the contents of the hashmap
-void d_hashmap(hashmap* map);                             // Frees all memory associated with the hashmap
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// A macro for calculating the DJB2 hash index (maps themselves hash with their hash_fn)
+#define HASH_INDEX(key, size) (hash(key) % (unsigned long)(size))
+// A macro for calculating the load factor
+#define LOAD_FACTOR(map) ((float) map -> count / map -> size)
+// A macro for our max factor (might lower it later)
+#define MAX_FACTOR 0.75
+// Number of old buckets an incremental rehash migrates per put/delete_key (lookups never migrate)
+#define HM_REHASH_STEP 16
+// Number of keys get_many hashes and prefetches before resolving any of them
+#define HM_PREFETCH_BATCH 16
+// Number of bins of the chain-length histogram of hm_stats; the last one also counts longer chains
+#define HM_STATS_HISTOGRAM 16
+// Number of buckets (or slots) ahead of the current one whose pair (or key) an iterator prefetches
+#define HM_ITER_PREFETCH_DISTANCE 16
+// Minimum number of old buckets per thread of a parallel rehash; smaller ones do not pay for the threads
+#define HM_PARALLEL_REHASH_MIN (32 * 1024)
+// Upper bound on the threads of one parallel rehash
+#define HM_PARALLEL_REHASH_MAX_THREADS 64
+// Bytes per slab of an arena-backed map
+#define HM_SLAB_SIZE (64 * 1024)
+// Arena key blocks are rounded up to a multiple of this many bytes
+#define HM_ARENA_CLASS_SIZE 16
+// Number of key size classes; longer keys (NUL included) fall back to malloc
+#define HM_ARENA_CLASSES 16
+
+// Number of control bytes scanned at once by the swiss engine (one SSE2 register)
+#define HM_GROUP_WIDTH 16
+// Control byte values for the swiss engine. A full slot stores the low 7 bits of its hash (0..127),
+// so both special values have the high bit set and can be told apart from full slots with one compare.
+#define HM_CTRL_EMPTY ((int8_t)-128)  // 0b10000000, never used
+#define HM_CTRL_DELETED ((int8_t)-2)  // 0b11111110, tombstone left behind by delete_key
+// A hash is split into H1, which picks the first group to probe, and H2, stored in the control byte
+#define HM_H1(h) ((h) >> 7)
+#define HM_H2(h) ((int8_t)((h) & 0x7F))
+
+// Signature of a hash function a map can use: hashes len bytes of data, varying with seed
+typedef uint64_t (*hm_hash_fn)(const void *data, size_t len, uint64_t seed);
+
+// Hash function used by maps created without opts->hash_fn.
+// Override at compile time, e.g. -DHM_DEFAULT_HASH=hm_hash_wy
+#ifndef HM_DEFAULT_HASH
+#define HM_DEFAULT_HASH hm_hash_djb2
+#endif
+
+// Mixes the bits of a hash so that both its low and its high bits depend on the whole key
+// (murmur3 64-bit finalizer). DJB2 leaves the high bits of short keys almost constant,
+// and a user supplied hash may be weak too, so maps mix before indexing with a mask.
+static inline uint64_t hm_mix64(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb3fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Returns a bitmask of the slots in a group of control bytes that equal value (bit i for group[i])
+static inline uint32_t hm_group_match(const int8_t *group, int8_t value)
+{
+#ifdef __SSE2__
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(value), ctrl));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < HM_GROUP_WIDTH; i++) {
+        mask |= (uint32_t)(group[i] == value) << i;
+    }
+    return mask;
+#endif
+}
+
+// Returns a bitmask of the slots in a group of control bytes that are EMPTY or DELETED
+static inline uint32_t hm_group_match_free(const int8_t *group)
+{
+#ifdef __SSE2__
+    // Both EMPTY (-128) and DELETED (-2) are smaller than -1, full slots (0..127) are not
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), ctrl));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < HM_GROUP_WIDTH; i++) {
+        mask |= (uint32_t)(group[i] < -1) << i;
+    }
+    return mask;
+#endif
+}
+
+// Number of slots that may be filled before an open-addressing table of the given capacity
+// (a power of two, at least HM_GROUP_WIDTH) must rehash: 7/8 of it
+static inline int hm_growth_cap(int capacity)
+{
+    return capacity - capacity / 8;
+}
+
+// Returns the first EMPTY or DELETED slot on the probe sequence of a hash. Probing is triangular
+// over whole groups, which visits every group once when the group count is a power of two.
+// The table must have at least one such slot, which the growth budget guarantees.
+static inline int hm_find_free(const int8_t *ctrl, int capacity, uint64_t h)
+{
+    int groupMask = capacity / HM_GROUP_WIDTH - 1;
+    int group = (int)(HM_H1(h) & (uint64_t)groupMask);
+
+    for (int step = 1; ; step++) {
+        uint32_t free_mask = hm_group_match_free(ctrl + (size_t)group * HM_GROUP_WIDTH);
+        if (free_mask) {
+            return group * HM_GROUP_WIDTH + __builtin_ctz(free_mask);
+        }
+        group = (group + step) & groupMask;
+    }
+}
+
+// Keys shorter than this are handed from hm_hash_simd to hm_hash_wy
+#define HM_SIMD_MIN_LEN 512
+
+// Keys shorter than this are stored inside the pair itself (NUL included)
+#define HM_INLINE_KEY_SIZE 24
+
+// Keys are stored as len bytes plus a terminating NUL (so string keys can be printed),
+// but compared by length and memcmp, so keys passed to the *_n functions may contain NUL bytes.
+
+// Structure to represent a key-value pair in the hashmap.
+// It includes a pointer to the next pair to handle collisions using separate chaining.
+// Use pair_key() to read the key, since short keys are stored inline.
+typedef struct pair
+{
+    union {
+        char inline_key[HM_INLINE_KEY_SIZE]; // Used when key_len < HM_INLINE_KEY_SIZE
+        char *heap_key;                      // Separately allocated copy of a longer key
+    } key;
+    uint32_t key_len;  // Length of the key, not counting the NUL
+    int value;
+    uint64_t hash;     // Full hash of the key (mixed in pow2 maps), so rehashing and chain walks rarely read the key
+    struct pair *next; // Pointer to the next pair in case of a collision (linked list)
+} pair;
+
+// Returns the key of a pair (key_len bytes plus a NUL), wherever it is stored
+static inline const char* pair_key(const pair *p)
+{
+    return p->key_len < HM_INLINE_KEY_SIZE ? p->key.inline_key : p->key.heap_key;
+}
+
+// Structure to represent a single slot of the swiss engine.
+// Slots are stored in one flat array, so a probe never follows a pointer to find the next candidate.
+typedef struct hm_slot
+{
+    char *key;         // Separately allocated, NUL-terminated copy of the key
+    uint64_t hash;     // Full (mixed) hash of the key, so rehashing never reads the key
+    uint32_t key_len;  // Length of the key, not counting the NUL
+    int value;
+} hm_slot;
+
+// A slab of an arena-backed map. Pairs and keys are carved from data in order.
+typedef struct hm_slab
+{
+    struct hm_slab *next; // Previously allocated slab
+    size_t used;          // Bytes of data handed out so far
+    size_t cap;           // Bytes of data in this slab
+    _Alignas(16) char data[];
+} hm_slab;
+
+// Per-map arena: the slabs plus freelists of released pairs and key blocks.
+typedef struct hm_arena
+{
+    hm_slab *slabs;                        // Newest slab first
+    pair *free_pairs;                      // Released pairs, linked through next
+    void *free_blocks[HM_ARENA_CLASSES];   // Released key blocks per size class, linked through their first bytes
+    int large_count;                       // Live keys too long for a size class (malloc'd)
+} hm_arena;
+
+// Storage engines a hashmap can be built on.
+typedef enum HashMapEngine {
+    HM_ENGINE_CHAINED = 0, // Separate chaining, an array of linked lists (default)
+    HM_ENGINE_SWISS,       // Open addressing with SwissTable-style control bytes
+    HM_ENGINE_SNAPSHOT,    // Read-only, served from a file mapped by hm_open_mmap (cannot be created by c_hashmap_ex)
+} HashMapEngine;
+
+// Options for c_hashmap_ex. A zeroed struct gives the same map as c_hashmap.
+typedef struct hashmap_options
+{
+    HashMapEngine engine;
+    bool incremental;      // Chained only: grow by migrating HM_REHASH_STEP buckets per put/delete_key instead of all at once
+    bool arena;            // Allocate pairs and keys from per-map slabs instead of malloc
+    bool pow2;             // Chained only: round the bucket count to a power of two and index with a mask
+    hm_hash_fn hash_fn;    // Hash function for keys, or NULL for HM_DEFAULT_HASH
+    uint64_t seed;         // Seed passed to hash_fn
+    float shrink_factor;   // Shrink after a delete once LOAD_FACTOR drops below this; 0 disables, must be < MAX_FACTOR / 2
+    int resize_threads;    // Chained only: threads a synchronous rehash of a large map is split across; 0 or 1 for none
+} hashmap_options;
+
+// Structure to represent the hashmap itself.
+// It contains the number of buckets and an array of pointers to pairs (the buckets).
+// A swiss map uses ctrl and slots instead of buckets; size is then the number of slots.
+typedef struct hashmap
+{
+    int size;          // Number of buckets in the hashmap
+    pair **buckets;    // Array of pointers to pairs (each bucket is a linked list)
+    int count;         // Number of key-value pairs
+    HashMapEngine engine; // Which engine the map was created with
+    int8_t *ctrl;      // Swiss: one control byte per slot, scanned HM_GROUP_WIDTH at a time
+    hm_slot *slots;    // Swiss: flat slot storage, parallel to ctrl
+    int growth_left;   // Swiss: inserts into EMPTY slots allowed before the next rehash
+    bool incremental;  // Whether growing the map migrates buckets incrementally
+    pair **old_buckets; // Bucket array being migrated away from, or NULL when no rehash is in progress
+    int old_size;      // Number of buckets in old_buckets
+    int rehash_pos;    // Old buckets below this index have already been migrated
+    hm_arena *arena;   // Slab allocator for pairs and keys, or NULL to use malloc
+    bool pow2;         // Power-of-two size: buckets are indexed by masking a mixed hash instead of %
+    hm_hash_fn hash_fn; // Hash function for keys
+    uint64_t seed;     // Seed passed to hash_fn
+    float shrink_factor; // Load factor below which delete_key shrinks the map (0 = never)
+    int min_size;      // Size the map was created with; automatic shrinking stops there
+    int resize_threads; // Threads a synchronous rehash may use (1 = the calling thread only)
+    const unsigned char *snapshot; // Snapshot: the mapped file
+    size_t snapshot_len; // Snapshot: length of the mapping
+} hashmap;
+
+// Position of an iterator over a map (hm_iter_begin / hm_iter_next). Entries are visited in
+// memory order: chained buckets followed by the old buckets of an unfinished incremental
+// rehash, swiss slots, or snapshot records. The map must not be modified during the walk
+// except through hm_iter_erase.
+typedef struct hm_iter
+{
+    hashmap *map;      // The map being walked
+    const char *key;   // Current entry: its key (NUL-terminated), or NULL before the first entry and after an erase
+    size_t key_len;    // Current entry: length of the key
+    int value;         // Current entry: its value
+    size_t pos;        // Next bucket (chained), slot (swiss) or record offset (snapshot) to look at
+    pair **link;       // Chained: the pointer to the current pair, which hm_iter_erase redirects
+    pair *current;     // Chained: the current pair, NULL once erased
+} hm_iter;
+
+// Occupancy figures of a map, filled in by hm_stats. For the swiss engine a "bucket" is a
+// group of HM_GROUP_WIDTH slots and a chain is the run of groups a probe sequence visits.
+typedef struct hashmap_stats
+{
+    int count;                // Number of key-value pairs
+    int buckets;              // Buckets examined (both arrays during an incremental rehash; groups for swiss)
+    float load_factor;        // count / size
+    int empty_buckets;        // Buckets holding no pair (swiss: groups with no full slot)
+    double empty_ratio;       // empty_buckets / buckets
+    int max_chain;            // Longest chain (swiss: longest probe of a stored key, in groups)
+    uint64_t chain_hist[HM_STATS_HISTOGRAM]; // Chained/snapshot: buckets per chain length; swiss: keys per probe length in groups
+    double avg_probes_hit;    // Pairs (swiss: groups) a lookup of a present key examines, averaged over the keys
+    double avg_probes_miss;   // Pairs (swiss: groups) a lookup of an absent key examines, averaged over the buckets
+    size_t bytes;             // Bytes of memory the map holds, allocator overhead excluded (snapshot: bytes mapped)
+} hashmap_stats;
+
+// Enum for function return status
+typedef enum HashMapStatus{
+    HM_SUCCESS = 0,
+    HM_ERR_MALLOC_FAILED,
+    HM_ERR_KEY_NOT_FOUND,
+    HM_ERR_INVALID_ARG,
+    HM_ERR_REHASHING_FAILED,
+    HM_ERR_CLEAR_FAILED,
+    HM_ERR_SIZE_LIMIT,
+    HM_ERR_READ_ONLY,
+    HM_ERR_IO,
+} HashMapStatus;
+
+// Snapshot files (hm_save / hm_open_mmap). All integers are in host byte order and every
+// section is 8-byte aligned, so the mapped file is used in place without any decoding:
+//
+//   hm_snapshot_header
+//   uint64_t bucket_starts[bucket_count + 1]   byte offsets into the entries section, in bucket order
+//   entries                                    hm_snapshot_entry records, grouped by bucket
+//
+// Keys are hashed with hm_mix64(hm_hash_wy(key, len, seed)) and bucket b holds the keys whose
+// hash & (bucket_count - 1) is b, between bucket_starts[b] and bucket_starts[b + 1].
+#define HM_SNAPSHOT_MAGIC "HMSNAP\0\1"
+#define HM_SNAPSHOT_VERSION 1
+#define HM_SNAPSHOT_MAX_BUCKETS (1 << 30)
+
+typedef struct hm_snapshot_header
+{
+    char magic[8];           // HM_SNAPSHOT_MAGIC
+    uint32_t version;        // HM_SNAPSHOT_VERSION
+    uint32_t byte_order;     // 0x01020304 as written, to reject files from a host of the other endianness
+    uint64_t seed;           // Seed of the key hash
+    uint64_t count;          // Number of entries
+    uint64_t bucket_count;   // Number of buckets (a power of two)
+    uint64_t buckets_offset; // File offset of bucket_starts
+    uint64_t entries_offset; // File offset of the entries section
+    uint64_t entries_len;    // Length of the entries section
+} hm_snapshot_header;
+
+typedef struct hm_snapshot_entry
+{
+    uint64_t hash;           // Hash of the key, as described above
+    uint32_t key_len;        // Length of the key
+    int32_t value;           // The value
+    char key[];              // The key bytes, NUL-terminated, padded to a multiple of 8
+} hm_snapshot_entry;
+
+// Streams (hm_stream_write / hm_stream_read). Unlike a snapshot, a stream is written and read
+// strictly in order, so it can go through a pipe, a socket or a compressor:
+//
+//   hm_stream_header
+//   batches: hm_stream_batch followed by its entries, each a hm_stream_entry and the key bytes
+//   an empty batch (entries == 0) marking the end
+//
+// Integers are in host byte order. A batch holds at most HM_STREAM_BATCH_ENTRIES entries and,
+// unless a single key is larger, HM_STREAM_BATCH_BYTES bytes, and is handed to the write
+// callback in one call; the reader asks for each batch with two calls.
+#define HM_STREAM_MAGIC "HMSTRM\0\1"
+#define HM_STREAM_VERSION 1
+#define HM_STREAM_BATCH_ENTRIES 1024
+#define HM_STREAM_BATCH_BYTES (64 * 1024)
+// Largest header count hm_stream_read presizes for; a corrupt or hostile header cannot make it
+// allocate more than this up front
+#define HM_STREAM_MAX_PRESIZE (1u << 20)
+
+typedef struct hm_stream_header
+{
+    char magic[8];           // HM_STREAM_MAGIC
+    uint32_t version;        // HM_STREAM_VERSION
+    uint32_t byte_order;     // 0x01020304 as written
+    uint64_t count;          // Number of entries that follow, used by the reader to presize
+} hm_stream_header;
+
+typedef struct hm_stream_batch
+{
+    uint32_t entries;        // Number of entries in the batch, 0 for the end marker
+    uint32_t bytes;          // Bytes of entries following this header
+} hm_stream_batch;
+
+typedef struct hm_stream_entry
+{
+    uint32_t key_len;        // Length of the key bytes that follow (not NUL-terminated)
+    int32_t value;           // The value
+} hm_stream_entry;
+
+// Write callback of hm_stream_write: consumes all len bytes, or returns false on error
+typedef bool (*hm_stream_write_fn)(void *ctx, const void *data, size_t len);
+// Read callback of hm_stream_read: reads up to len bytes into buf, returning how many (0 at end
+// of input or on error); short reads are fine, the reader calls again for the rest
+typedef size_t (*hm_stream_read_fn)(void *ctx, void *buf, size_t len);
+
+// Function declarations
+unsigned long hash(const char* string);                    // Hashes a string to an unsigned long
+uint64_t hm_hash_djb2(const void *data, size_t len, uint64_t seed); // DJB2 over len bytes (same as hash() for seed 0)
+uint64_t hm_hash_wy(const void *data, size_t len, uint64_t seed);   // Fast word-at-a-time hash (wyhash construction)
+uint64_t hm_hash_simd(const void *data, size_t len, uint64_t seed); // SIMD hash for long keys (AVX2/SSE2/scalar, picked at runtime)
+uint64_t hm_hash_simd_scalar(const void *data, size_t len, uint64_t seed); // hm_hash_simd without vector instructions
+const char* hm_hash_simd_kernel(void);                     // Name of the kernel hm_hash_simd runs on this CPU
+hashmap* c_hashmap(int size);                              // Creates and initializes a new hashmap
+hashmap* c_hashmap_ex(int size, const hashmap_options *opts); // Creates a hashmap with explicit options
+HashMapStatus put(hashmap* map, const char *key, int value); // Inserts or updates a key-value pair
+HashMapStatus get(const hashmap* map, const char *key, int *value); // Retrieves the value associated with a key
+HashMapStatus delete_key(hashmap* map, const char *key);   // Deletes a key-value pair
+HashMapStatus resize(hashmap* map);                        // Dynamic resizing
+HashMapStatus reserve(hashmap* map, size_t n_entries);     // Grows the map to hold n_entries without resizing
+HashMapStatus shrink_to_fit(hashmap* map);                 // Shrinks the map to fit its current entries
+bool contains_key(const hashmap* map, const char *key);   // Checks if a key exists in the hashmap
+// Length-aware variants: the key is len arbitrary bytes (may contain NUL, need not be terminated)
+HashMapStatus put_n(hashmap* map, const void *key, size_t len, int value);
+HashMapStatus get_n(const hashmap* map, const void *key, size_t len, int *value);
+HashMapStatus delete_n(hashmap* map, const void *key, size_t len);
+bool contains_n(const hashmap* map, const void *key, size_t len);
+// Pre-hashed variants for front ends that already hashed the key (hash = map->hash_fn(key, len, map->seed))
+HashMapStatus hm_put_hashed(hashmap* map, const void *key, size_t len, uint64_t hash, int value);
+HashMapStatus hm_get_hashed(const hashmap* map, const void *key, size_t len, uint64_t hash, int *value);
+HashMapStatus hm_delete_hashed(hashmap* map, const void *key, size_t len, uint64_t hash);
+bool hm_contains_hashed(const hashmap* map, const void *key, size_t len, uint64_t hash);
+// Looks up n keys at once with software prefetching; statuses[i] tells whether values[i] was set
+HashMapStatus get_many(const hashmap* map, const char *const *keys, size_t n, int *values, HashMapStatus *statuses);
+// Inserts n pairs at once after growing the map to its final size up front
+HashMapStatus put_many(hashmap* map, const char *const *keys, const int *values, size_t n);
+// Snapshot files: write a map out, and serve get/contains_key straight from the mapped file
+HashMapStatus hm_save(const hashmap* map, const char *path);
+hashmap* hm_open_mmap(const char *path);
+// Iteration: walk every entry in memory order, optionally erasing some on the way
+HashMapStatus hm_iter_begin(hashmap* map, hm_iter *it);
+bool hm_iter_next(hm_iter *it);
+HashMapStatus hm_iter_erase(hm_iter *it);
+void p_hashmap(const hashmap* map);                        // Prints the contents of the hashmap
+HashMapStatus hm_stats(const hashmap* map, hashmap_stats *out); // Occupancy and chain-length statistics, one pass without reading keys
+// Streams: write a map through a callback in batches, and load one into a map presized from its header
+HashMapStatus hm_stream_write(const hashmap* map, hm_stream_write_fn write_fn, void *ctx);
+HashMapStatus hm_stream_read(hashmap* map, hm_stream_read_fn read_fn, void *ctx);
+bool hm_stream_file_write(void *ctx, const void *data, size_t len); // Write callback for a FILE* ctx
+size_t hm_stream_file_read(void *ctx, void *buf, size_t len);       // Read callback for a FILE* ctx
+// TODO: 
+HashMapStatus clear(hashmap* map);                         // Clears all key-value pairs from the hashmap
+void d_hashmap(hashmap* map);                             // Frees all memory associated with the hashmap
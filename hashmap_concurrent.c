@@ -0,0 +1,557 @@
+#pragma GCC optimize("O3")
+
+#include "hashmap_concurrent.h"
+
+/*
+ * Locking protocol
+ *
+ * A key's stripe is the low bits of its (mixed) hash, which are also the low
+ * bits of its bucket index whatever the table size, so every operation locks
+ * exactly one stripe: read for lookups, write for updates. While a thread holds
+ * any stripe lock, table cannot change.
+ *
+ * A resize is done by one thread at a time (resize_lock). It allocates the new
+ * table without holding any stripe, then write-locks one stripe at a time to
+ * move that stripe's chains and mark it migrated; meanwhile operations on a
+ * migrated stripe use new_table and the others keep using table. Only the
+ * final pointer swap takes all stripes, in index order, for a few stores.
+ * Threads never wait for resize_lock while holding a stripe, so the two kinds
+ * of locks cannot deadlock.
+ *
+ * Lock-free reads
+ *
+ * With lockfree_reads, lookups take no lock at all. Writers still serialize on
+ * the stripe, but publish every link and value with atomic stores, so a reader
+ * walking a chain always sees a well-formed one: a new pair is complete before
+ * it becomes a bucket head, and an unlinked pair keeps its next pointer. Pairs
+ * and tables are freed through hm_epoch, after every reader that might still
+ * hold them has finished. Only a resize moves pairs between chains; a reader
+ * racing with it could then miss a key, so misses are validated against the
+ * stripe's seq counter and retried. Hits need no validation.
+ */
+
+/**
+ * @brief Returns the stripe a hash belongs to.
+ */
+static inline chm_stripe* chm_stripe_of(const chashmap* map, uint64_t h)
+{
+    return &map->stripes[h & (uint64_t)(map->stripe_count - 1)];
+}
+
+/**
+ * @brief Returns the bucket a hash lives in. The caller must hold the hash's stripe lock.
+ */
+static inline pair** chm_bucket(const chashmap* map, const chm_stripe* stripe, uint64_t h)
+{
+    chm_table* table = stripe->migrated ? map->new_table : map->table;
+    return &table->buckets[h & (uint64_t)(table->size - 1)];
+}
+
+/**
+ * @brief Checks whether a pair holds a given key, comparing the cached hash and length first.
+ */
+static inline bool chm_matches(const pair* p, const char *key, size_t len, uint64_t h)
+{
+    return p->hash == h && p->key_len == len && memcmp(pair_key(p), key, len) == 0;
+}
+
+/**
+ * @brief Finds a key in a chain.
+ * @return The pair holding the key, or NULL.
+ */
+static pair* chm_find(pair* current, const char *key, size_t len, uint64_t h)
+{
+    while (current && !chm_matches(current, key, len, h)) {
+        current = current->next;
+    }
+    return current;
+}
+
+/**
+ * @brief Finds a key without taking any lock. The caller must be inside an hm_epoch
+ * critical section, which keeps the returned pair alive until it leaves.
+ * @return The pair holding the key, or NULL.
+ */
+static pair* chm_find_lockfree(const chashmap* map, const chm_stripe* stripe, const char *key, size_t len, uint64_t h)
+{
+    for (;;) {
+        unsigned seq = __atomic_load_n(&stripe->seq, __ATOMIC_ACQUIRE);
+        chm_table* table = NULL;
+        if (__atomic_load_n(&stripe->migrated, __ATOMIC_ACQUIRE)) {
+            table = __atomic_load_n(&map->new_table, __ATOMIC_ACQUIRE); // NULL once the resize has finished
+        }
+        if (!table) {
+            table = __atomic_load_n(&map->table, __ATOMIC_ACQUIRE);
+        }
+
+        pair* current = __atomic_load_n(&table->buckets[h & (uint64_t)(table->size - 1)], __ATOMIC_ACQUIRE);
+        while (current && !chm_matches(current, key, len, h)) {
+            current = __atomic_load_n(&current->next, __ATOMIC_ACQUIRE);
+        }
+        if (current) {
+            return current;
+        }
+
+        // A miss only counts if no resize moved this stripe's chains while we walked them
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (!(seq & 1) && __atomic_load_n(&stripe->seq, __ATOMIC_RELAXED) == seq) {
+            return NULL;
+        }
+    }
+}
+
+/**
+ * @brief Allocates a table with every bucket empty.
+ * @return The table, or NULL if memory allocation fails.
+ */
+static chm_table* chm_table_new(int size)
+{
+    chm_table* table = calloc(1, sizeof(chm_table) + (size_t)size * sizeof(pair*));
+    if (table) {
+        table->size = size;
+    }
+    return table;
+}
+
+/**
+ * @brief Allocates a pair for a key, storing short keys inline as hashmap does.
+ * @return The pair, or NULL if memory allocation fails.
+ */
+static pair* chm_pair_new(const char *key, size_t len, uint64_t h, int value)
+{
+    pair* p = malloc(sizeof(pair));
+    if (!p) {
+        return NULL;
+    }
+    char *dest = p->key.inline_key;
+    if (len >= HM_INLINE_KEY_SIZE) {
+        dest = p->key.heap_key = malloc(len + 1);
+        if (!dest) {
+            free(p);
+            return NULL;
+        }
+    }
+    memcpy(dest, key, len);
+    dest[len] = '\0';
+    p->key_len = (uint32_t)len;
+    p->hash = h;
+    p->value = value;
+    return p;
+}
+
+/**
+ * @brief Frees a pair allocated with chm_pair_new.
+ */
+static void chm_pair_free(pair* p)
+{
+    if (p->key_len >= HM_INLINE_KEY_SIZE) {
+        free(p->key.heap_key);
+    }
+    free(p);
+}
+
+// chm_pair_free with the signature hm_epoch_retire expects
+static void chm_pair_release(void *p)
+{
+    chm_pair_free(p);
+}
+
+/**
+ * @brief Creates and initializes a new concurrent hashmap.
+ * @param size The desired number of buckets (rounded up to a power of two, and to at least
+ *             CHM_MIN_BUCKETS_PER_STRIPE per stripe).
+ * @param opts Optional settings, or NULL for the defaults.
+ * @return A pointer to the newly created map, or NULL if the arguments are invalid or memory allocation fails.
+ */
+chashmap* c_chashmap_ex(int size, const chashmap_options *opts)
+{
+    chashmap_options defaults = { 0 };
+    if (!opts) {
+        opts = &defaults;
+    }
+    // Validate inputs
+    if (size <= 0 || opts->stripes < 0 || size > (1 << 30) || opts->stripes > (1 << 16)) {
+        fprintf(stderr, "Error: Invalid size or stripe count for concurrent hashmap.\n");
+        return NULL;
+    }
+
+    int stripeCount = 1;
+    while (stripeCount < (opts->stripes ? opts->stripes : CHM_DEFAULT_STRIPES)) {
+        stripeCount <<= 1;
+    }
+    int bucketCount = stripeCount * CHM_MIN_BUCKETS_PER_STRIPE;
+    while (bucketCount < size) {
+        bucketCount <<= 1;
+    }
+
+    chashmap* map = calloc(1, sizeof(chashmap));
+    if (!map) {
+        perror("Error: Failed to allocate memory for concurrent hashmap");
+        return NULL;
+    }
+    map->stripe_count = stripeCount;
+    map->hash_fn = opts->hash_fn ? opts->hash_fn : HM_DEFAULT_HASH;
+    map->seed = opts->seed;
+    map->lockfree_reads = opts->lockfree_reads;
+    map->table = chm_table_new(bucketCount);
+    map->stripes = aligned_alloc(_Alignof(chm_stripe), (size_t)stripeCount * sizeof(chm_stripe));
+    if (!map->table || !map->stripes) {
+        perror("Error: Failed to allocate memory for concurrent hashmap buckets");
+        free(map->table);
+        free(map->stripes);
+        free(map);
+        return NULL;
+    }
+
+    for (int i = 0; i < stripeCount; i++) {
+        pthread_rwlock_init(&map->stripes[i].lock, NULL);
+        map->stripes[i].count = 0;
+        map->stripes[i].migrated = false;
+        map->stripes[i].seq = 0;
+    }
+    pthread_mutex_init(&map->resize_lock, NULL);
+    return map;
+}
+
+/**
+ * @brief Creates and initializes a new concurrent hashmap.
+ * @param size The desired number of buckets (rounded up to a power of two, and to at least
+ *             CHM_MIN_BUCKETS_PER_STRIPE per stripe).
+ * @param stripes The desired number of lock stripes (rounded up to a power of two), or 0 for CHM_DEFAULT_STRIPES.
+ * @param hash_fn Hash function for keys, or NULL for HM_DEFAULT_HASH.
+ * @param seed Seed passed to hash_fn.
+ * @return A pointer to the newly created map, or NULL if the arguments are invalid or memory allocation fails.
+ */
+chashmap* c_chashmap(int size, int stripes, hm_hash_fn hash_fn, uint64_t seed)
+{
+    chashmap_options opts = { .stripes = stripes, .hash_fn = hash_fn, .seed = seed };
+    return c_chashmap_ex(size, &opts);
+}
+
+/**
+ * @brief Hashes a key. Stripes and buckets are picked with masks, so the hash is mixed.
+ */
+static inline uint64_t chm_hash(const chashmap* map, const char *key, size_t len)
+{
+    return hm_mix64(map->hash_fn(key, len, map->seed));
+}
+
+static HashMapStatus chm_grow(chashmap* map, int seenSize);
+
+/**
+ * @brief Inserts a new key-value pair, or updates the value if the key already exists.
+ * Grows the map once the stripe of the key exceeds MAX_FACTOR.
+ * @param map A pointer to the concurrent hashmap.
+ * @param key The string key.
+ * @param value The integer value.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus chm_put(chashmap* map, const char *key, int value)
+{
+    // Validate inputs
+    if (!map || !key) {
+        fprintf(stderr, "Error: Invalid hashmap or key provided to chm_put.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    size_t len = strlen(key);
+    if (len >= UINT32_MAX) {
+        fprintf(stderr, "Error: Key is too long.\n");
+        return HM_ERR_SIZE_LIMIT;
+    }
+    uint64_t h = chm_hash(map, key, len);
+    chm_stripe* stripe = chm_stripe_of(map, h);
+
+    // Updates of an existing key are done without allocating
+    pthread_rwlock_wrlock(&stripe->lock);
+    pair* existing = chm_find(*chm_bucket(map, stripe, h), key, len, h);
+    if (existing) {
+        __atomic_store_n(&existing->value, value, __ATOMIC_RELAXED);
+        pthread_rwlock_unlock(&stripe->lock);
+        return HM_SUCCESS;
+    }
+    pthread_rwlock_unlock(&stripe->lock);
+
+    // A new key: allocate outside the lock, then check again, since another thread may
+    // have inserted the key (or a resize moved the buckets) while the lock was released
+    pair* new_pair = chm_pair_new(key, len, h, value);
+    if (!new_pair) {
+        perror("Error: Failed to allocate memory for new pair");
+        return HM_ERR_MALLOC_FAILED;
+    }
+
+    pthread_rwlock_wrlock(&stripe->lock);
+    pair** bucket = chm_bucket(map, stripe, h);
+    existing = chm_find(*bucket, key, len, h);
+    if (existing) {
+        __atomic_store_n(&existing->value, value, __ATOMIC_RELAXED);
+        pthread_rwlock_unlock(&stripe->lock);
+        chm_pair_free(new_pair);
+        return HM_SUCCESS;
+    }
+    new_pair->next = *bucket;
+    __atomic_store_n(bucket, new_pair, __ATOMIC_RELEASE); // Publishes the complete pair to lock-free readers
+    __atomic_store_n(&stripe->count, stripe->count + 1, __ATOMIC_RELAXED);
+    // Each stripe owns size / stripe_count buckets
+    int seenSize = map->table->size;
+    bool grow = stripe->count > (double)seenSize / map->stripe_count * MAX_FACTOR;
+    pthread_rwlock_unlock(&stripe->lock);
+
+    if (grow && chm_grow(map, seenSize) != HM_SUCCESS) {
+        fprintf(stderr, "Warning: Hashmap resize failed after put.\n");
+        return HM_ERR_REHASHING_FAILED;
+    }
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Retrieves the value associated with a key. Concurrent lookups of keys in the
+ * same stripe share its lock, or take no lock at all with lockfree_reads.
+ * @param map A pointer to the concurrent hashmap.
+ * @param key The string key to search for.
+ * @param value Pointer to store the retrieved value.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus chm_get(chashmap* map, const char *key, int *value)
+{
+    // Validate inputs
+    if (!map || !key || !value) {
+        fprintf(stderr, "Error: Invalid hashmap, key, or value pointer provided to chm_get.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    size_t len = strlen(key);
+    uint64_t h = chm_hash(map, key, len);
+    chm_stripe* stripe = chm_stripe_of(map, h);
+
+    pair* found;
+    if (map->lockfree_reads && hm_epoch_enter()) {
+        found = chm_find_lockfree(map, stripe, key, len, h);
+        if (found) {
+            *value = __atomic_load_n(&found->value, __ATOMIC_RELAXED);
+        }
+        hm_epoch_exit();
+    } else {
+        pthread_rwlock_rdlock(&stripe->lock);
+        found = chm_find(*chm_bucket(map, stripe, h), key, len, h);
+        if (found) {
+            *value = found->value;
+        }
+        pthread_rwlock_unlock(&stripe->lock);
+    }
+
+    return found ? HM_SUCCESS : HM_ERR_KEY_NOT_FOUND;
+}
+
+/**
+ * @brief Checks whether a key exists in the concurrent hashmap.
+ * @param map A pointer to the concurrent hashmap.
+ * @param key The string key to search for.
+ * @return true if the key exists, false if it does not or the arguments are invalid.
+ */
+bool chm_contains(chashmap* map, const char *key)
+{
+    // Validate inputs
+    if (!map || !key) {
+        fprintf(stderr, "Error: Invalid hashmap or key provided to chm_contains.\n");
+        return false;
+    }
+    size_t len = strlen(key);
+    uint64_t h = chm_hash(map, key, len);
+    chm_stripe* stripe = chm_stripe_of(map, h);
+
+    bool found;
+    if (map->lockfree_reads && hm_epoch_enter()) {
+        found = chm_find_lockfree(map, stripe, key, len, h) != NULL;
+        hm_epoch_exit();
+    } else {
+        pthread_rwlock_rdlock(&stripe->lock);
+        found = chm_find(*chm_bucket(map, stripe, h), key, len, h) != NULL;
+        pthread_rwlock_unlock(&stripe->lock);
+    }
+    return found;
+}
+
+/**
+ * @brief Deletes a key-value pair from the concurrent hashmap.
+ * @param map A pointer to the concurrent hashmap.
+ * @param key The string key of the pair to delete.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus chm_delete(chashmap* map, const char *key)
+{
+    // Validate inputs
+    if (!map || !key) {
+        fprintf(stderr, "Error: Invalid hashmap or key provided to chm_delete.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    size_t len = strlen(key);
+    uint64_t h = chm_hash(map, key, len);
+    chm_stripe* stripe = chm_stripe_of(map, h);
+
+    pthread_rwlock_wrlock(&stripe->lock);
+    pair** link = chm_bucket(map, stripe, h);
+    while (*link && !chm_matches(*link, key, len, h)) {
+        link = &(*link)->next;
+    }
+    pair* current = *link;
+    if (current) {
+        // Unlink; the pair keeps its next pointer for lock-free readers still standing on it
+        __atomic_store_n(link, current->next, __ATOMIC_RELEASE);
+        __atomic_store_n(&stripe->count, stripe->count - 1, __ATOMIC_RELAXED);
+    }
+    pthread_rwlock_unlock(&stripe->lock);
+
+    if (!current) {
+        return HM_ERR_KEY_NOT_FOUND;
+    }
+    if (map->lockfree_reads) {
+        hm_epoch_retire(current, chm_pair_release);
+    } else {
+        chm_pair_free(current); // No reader can hold it since they need the stripe lock
+    }
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Doubles the number of buckets if nobody did since the caller saw seenSize.
+ * Stripes are migrated one at a time, so each stripe is only blocked while its own
+ * chains move, and all stripes are taken together only for the final pointer swap.
+ * If another thread is already resizing, returns immediately.
+ * @param map A pointer to the concurrent hashmap.
+ * @param seenSize The size that made the caller decide to grow, or 0 to grow unconditionally.
+ * @return HashMapStatus indicating success or failure type.
+ */
+static HashMapStatus chm_grow(chashmap* map, int seenSize)
+{
+    if (pthread_mutex_trylock(&map->resize_lock) != 0) {
+        return HM_SUCCESS; // Someone else is growing the map already
+    }
+
+    // Only the resizer changes table, so it can read it without a stripe lock
+    chm_table* oldTable = map->table;
+    int oldSize = oldTable->size;
+    if (seenSize && seenSize != oldSize) {
+        pthread_mutex_unlock(&map->resize_lock);
+        return HM_SUCCESS; // Grown since the caller looked
+    }
+    int newSize;
+    if (__builtin_mul_overflow(oldSize, 2, &newSize)) {
+        pthread_mutex_unlock(&map->resize_lock);
+        fprintf(stderr, "Error: Cannot resize hashmap - size overflow.\n");
+        return HM_ERR_SIZE_LIMIT;
+    }
+    chm_table* newTable = chm_table_new(newSize);
+    if (!newTable) {
+        pthread_mutex_unlock(&map->resize_lock);
+        fprintf(stderr, "Error: Failed to allocate memory for new buckets during resize.\n");
+        return HM_ERR_MALLOC_FAILED;
+    }
+    // Nobody reads it until a stripe is marked migrated
+    __atomic_store_n(&map->new_table, newTable, __ATOMIC_RELEASE);
+
+    // Move the chains of one stripe at a time
+    for (int s = 0; s < map->stripe_count; s++) {
+        chm_stripe* stripe = &map->stripes[s];
+        pthread_rwlock_wrlock(&stripe->lock);
+        __atomic_store_n(&stripe->seq, stripe->seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        for (int i = s; i < oldSize; i += map->stripe_count) {
+            // Relinking keeps every chain finite, so a lock-free reader caught in one still terminates
+            pair* current = oldTable->buckets[i];
+            while (current) {
+                pair* temp = current;
+                current = current->next;
+                pair** newBucket = &newTable->buckets[temp->hash & (uint64_t)(newSize - 1)];
+                __atomic_store_n(&temp->next, *newBucket, __ATOMIC_RELAXED);
+                __atomic_store_n(newBucket, temp, __ATOMIC_RELEASE);
+            }
+        }
+        __atomic_store_n(&stripe->migrated, true, __ATOMIC_RELEASE);
+        __atomic_store_n(&stripe->seq, stripe->seq + 1, __ATOMIC_RELEASE);
+        pthread_rwlock_unlock(&stripe->lock);
+    }
+
+    // Swap the tables under all stripes, taken in index order
+    for (int s = 0; s < map->stripe_count; s++) {
+        pthread_rwlock_wrlock(&map->stripes[s].lock);
+    }
+    // Readers that still see migrated find table already swapped once new_table reads NULL
+    __atomic_store_n(&map->table, newTable, __ATOMIC_RELEASE);
+    for (int s = map->stripe_count - 1; s >= 0; s--) {
+        __atomic_store_n(&map->stripes[s].migrated, false, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&map->new_table, NULL, __ATOMIC_RELEASE);
+    for (int s = map->stripe_count - 1; s >= 0; s--) {
+        pthread_rwlock_unlock(&map->stripes[s].lock);
+    }
+
+    pthread_mutex_unlock(&map->resize_lock);
+    if (map->lockfree_reads) {
+        hm_epoch_retire(oldTable, free);
+    } else {
+        free(oldTable);
+    }
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Doubles the number of buckets while other threads keep using the map.
+ * If another thread is already resizing, returns without waiting for it.
+ * @param map A pointer to the concurrent hashmap.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus chm_resize(chashmap* map)
+{
+    // Validate input
+    if (!map) {
+        fprintf(stderr, "Error: Invalid hashmap provided to chm_resize.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    return chm_grow(map, 0);
+}
+
+/**
+ * @brief Returns the number of pairs. Under concurrent updates this is a snapshot that
+ * may be slightly out of date by the time it returns.
+ * @param map A pointer to the concurrent hashmap.
+ * @return The number of pairs, or 0 if map is NULL.
+ */
+int chm_count(chashmap* map)
+{
+    if (!map) {
+        return 0;
+    }
+    int count = 0;
+    for (int s = 0; s < map->stripe_count; s++) {
+        count += __atomic_load_n(&map->stripes[s].count, __ATOMIC_RELAXED);
+    }
+    return count;
+}
+
+/**
+ * @brief Frees all memory associated with the concurrent hashmap.
+ * No other thread may use the map during or after this call. With lockfree_reads, pairs
+ * deleted earlier may still be waiting in hm_epoch; they are freed independently of the map.
+ * @param map A pointer to the concurrent hashmap to be deallocated.
+ */
+void d_chashmap(chashmap* map)
+{
+    if (!map) {
+        return; // Nothing to free if map is NULL
+    }
+
+    for (int i = 0; i < map->table->size; i++) {
+        pair* current = map->table->buckets[i];
+        while (current) {
+            pair* temp = current;
+            current = current->next;
+            chm_pair_free(temp);
+        }
+    }
+    for (int s = 0; s < map->stripe_count; s++) {
+        pthread_rwlock_destroy(&map->stripes[s].lock);
+    }
+    pthread_mutex_destroy(&map->resize_lock);
+    free(map->table);
+    free(map->stripes);
+    free(map);
+}
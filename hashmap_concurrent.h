@@ -0,0 +1,63 @@
+#pragma once
+
+#include "hashmap.h"
+#include "hashmap_epoch.h"
+
+#include <pthread.h>
+
+// Default number of lock stripes of a concurrent hashmap
+#define CHM_DEFAULT_STRIPES 64
+// Minimum number of buckets per stripe, so per-stripe load factors stay meaningful
+#define CHM_MIN_BUCKETS_PER_STRIPE 16
+
+// A lock stripe. Bucket i belongs to stripe i % stripe_count, and since both counts are
+// powers of two a key keeps its stripe when the table doubles. Each stripe sits on its
+// own cache line so that threads working on different stripes never share one.
+typedef struct chm_stripe
+{
+    _Alignas(64) pthread_rwlock_t lock; // Read-locked by lookups, write-locked by updates
+    int count;                          // Pairs in this stripe's buckets
+    bool migrated;                      // During a resize: this stripe's buckets already live in new_table
+    unsigned seq;                       // Odd while a resize moves this stripe's chains
+} chm_stripe;
+
+// A bucket array together with its size, so that a lock-free reader always sees a matching pair
+typedef struct chm_table
+{
+    int size;                 // Number of buckets (a power of two)
+    pair *buckets[];          // Array of pointers to pairs
+} chm_table;
+
+// Structure to represent a thread-safe hashmap with striped reader/writer locks.
+// Buckets are chains of pairs, as in the chained engine of hashmap.
+typedef struct chashmap
+{
+    chm_table *table;         // The buckets
+    int stripe_count;         // Number of lock stripes (a power of two, at most the number of buckets)
+    chm_stripe *stripes;      // The lock stripes
+    chm_table *new_table;     // During a resize: the table stripes are being moved to, otherwise NULL
+    pthread_mutex_t resize_lock; // Held by the one thread resizing the map
+    hm_hash_fn hash_fn;       // Hash function for keys
+    uint64_t seed;            // Seed passed to hash_fn
+    bool lockfree_reads;      // Lookups take no lock; unlinked pairs and tables are freed through hm_epoch
+} chashmap;
+
+// Optional settings for c_chashmap_ex. A zeroed struct gives the defaults.
+typedef struct chashmap_options
+{
+    int stripes;              // Number of lock stripes (rounded up to a power of two), 0 for CHM_DEFAULT_STRIPES
+    hm_hash_fn hash_fn;       // Hash function for keys, NULL for HM_DEFAULT_HASH
+    uint64_t seed;            // Seed passed to hash_fn
+    bool lockfree_reads;      // chm_get/chm_contains use epoch-protected atomic loads instead of read locks
+} chashmap_options;
+
+// Function declarations
+chashmap* c_chashmap(int size, int stripes, hm_hash_fn hash_fn, uint64_t seed); // Creates a concurrent hashmap
+chashmap* c_chashmap_ex(int size, const chashmap_options *opts);         // Creates a concurrent hashmap with options
+HashMapStatus chm_put(chashmap* map, const char *key, int value);        // Inserts or updates a key-value pair
+HashMapStatus chm_get(chashmap* map, const char *key, int *value);       // Retrieves the value associated with a key
+HashMapStatus chm_delete(chashmap* map, const char *key);                // Deletes a key-value pair
+bool chm_contains(chashmap* map, const char *key);                       // Checks if a key exists
+HashMapStatus chm_resize(chashmap* map);                                 // Doubles the number of buckets
+int chm_count(chashmap* map);                                            // Number of pairs (a snapshot under concurrent updates)
+void d_chashmap(chashmap* map);                                          // Frees the map; no other thread may be using it
@@ -0,0 +1,222 @@
+#pragma GCC optimize("O3")
+
+#include "hashmap_epoch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+/*
+ * Classic three-epoch scheme. A pointer retired while the global epoch is e can
+ * only still be held by threads that entered their critical section in epoch e
+ * or earlier. The global epoch only moves from e to e + 1 once every thread in a
+ * critical section has announced e, so when it reaches e + 2 nobody can hold
+ * the pointer anymore and it is freed.
+ */
+
+static uint64_t hm_global_epoch = 1;           // Current global epoch
+static hm_epoch_record *hm_records;            // Every record ever allocated
+static _Thread_local hm_epoch_record *hm_self; // Record owned by the calling thread
+static pthread_once_t hm_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t hm_key;                   // Releases the record when its thread exits
+
+/**
+ * @brief Frees every pointer of a limbo list.
+ */
+static void limbo_free(hm_limbo *limbo)
+{
+    for (size_t i = 0; i < limbo->count; i++) {
+        limbo->items[i].free_fn(limbo->items[i].ptr);
+    }
+    limbo->count = 0;
+}
+
+/**
+ * @brief Frees the limbo lists of a record that no reader can reach anymore.
+ * @param r The record.
+ * @param epoch The current global epoch.
+ */
+static void collect(hm_epoch_record *r, uint64_t epoch)
+{
+    for (int i = 0; i < 3; i++) {
+        if (r->limbo[i].count && r->limbo[i].epoch + 2 <= epoch) {
+            limbo_free(&r->limbo[i]);
+        }
+    }
+}
+
+/**
+ * @brief Called when a thread exits; hands its record, limbo lists included, to the next thread.
+ */
+static void release_record(void *arg)
+{
+    hm_epoch_record *r = arg;
+    r->nesting = 0;
+    __atomic_store_n(&r->state, 0, __ATOMIC_RELEASE);
+    collect(r, __atomic_load_n(&hm_global_epoch, __ATOMIC_ACQUIRE));
+    __atomic_store_n(&r->in_use, false, __ATOMIC_RELEASE);
+}
+
+static void create_key(void)
+{
+    if (pthread_key_create(&hm_key, release_record) != 0) {
+        fprintf(stderr, "Warning: Epoch records of exiting threads will not be reused.\n");
+    }
+}
+
+/**
+ * @brief Returns the record of the calling thread, claiming or allocating one on first use.
+ * @return The record, or NULL if memory allocation fails.
+ */
+static hm_epoch_record* self_record(void)
+{
+    if (hm_self) {
+        return hm_self;
+    }
+    pthread_once(&hm_key_once, create_key);
+
+    // Reuse the record of a thread that has exited
+    hm_epoch_record *r = __atomic_load_n(&hm_records, __ATOMIC_ACQUIRE);
+    for (; r; r = r->next) {
+        bool expected = false;
+        if (!__atomic_load_n(&r->in_use, __ATOMIC_RELAXED) &&
+            __atomic_compare_exchange_n(&r->in_use, &expected, true, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    if (!r) {
+        r = aligned_alloc(_Alignof(hm_epoch_record), sizeof(hm_epoch_record));
+        if (!r) {
+            perror("Error: Failed to allocate memory for epoch record");
+            return NULL;
+        }
+        memset(r, 0, sizeof(hm_epoch_record));
+        r->in_use = true;
+        r->next = __atomic_load_n(&hm_records, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&hm_records, &r->next, r, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            // r->next was refreshed by the failed exchange
+        }
+    }
+
+    pthread_setspecific(hm_key, r);
+    hm_self = r;
+    return r;
+}
+
+/**
+ * @brief Moves the global epoch forward if every thread in a critical section has seen it.
+ * @return true if the epoch advanced (by this or another thread).
+ */
+static bool try_advance(void)
+{
+    uint64_t epoch = __atomic_load_n(&hm_global_epoch, __ATOMIC_ACQUIRE);
+    for (hm_epoch_record *r = __atomic_load_n(&hm_records, __ATOMIC_ACQUIRE); r; r = r->next) {
+        uint64_t state = __atomic_load_n(&r->state, __ATOMIC_ACQUIRE);
+        if ((state & 1) && (state >> 1) != epoch) {
+            return false; // A reader still lives in an older epoch
+        }
+    }
+    __atomic_compare_exchange_n(&hm_global_epoch, &epoch, epoch + 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    return true;
+}
+
+/**
+ * @brief Enters a critical section. Pointers loaded from shared structures stay valid until
+ * the matching hm_epoch_exit, even if a writer unlinks and retires them meanwhile.
+ * @return true on success, false if the thread's record could not be allocated; the caller
+ *         must then not call hm_epoch_exit and should fall back to locking.
+ */
+bool hm_epoch_enter(void)
+{
+    hm_epoch_record *r = self_record();
+    if (!r) {
+        return false;
+    }
+    if (r->nesting++ == 0) {
+        uint64_t epoch = __atomic_load_n(&hm_global_epoch, __ATOMIC_RELAXED);
+        // Sequentially consistent so the announcement is visible before any shared pointer is loaded
+        __atomic_store_n(&r->state, (epoch << 1) | 1, __ATOMIC_SEQ_CST);
+    }
+    return true;
+}
+
+/**
+ * @brief Leaves a critical section entered with hm_epoch_enter.
+ */
+void hm_epoch_exit(void)
+{
+    hm_epoch_record *r = hm_self;
+    if (--r->nesting == 0) {
+        __atomic_store_n(&r->state, 0, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @brief Waits until everything retired before the call can be freed, and frees what the calling
+ * thread retired. Must not be called from inside a critical section.
+ */
+void hm_epoch_synchronize(void)
+{
+    uint64_t target = __atomic_load_n(&hm_global_epoch, __ATOMIC_ACQUIRE) + 2;
+    uint64_t epoch;
+    while ((epoch = __atomic_load_n(&hm_global_epoch, __ATOMIC_ACQUIRE)) < target) {
+        if (!try_advance()) {
+            sched_yield();
+        }
+    }
+    if (hm_self) {
+        collect(hm_self, epoch);
+    }
+}
+
+/**
+ * @brief Schedules a pointer to be freed once no thread can still hold it. The pointer
+ * must already be unreachable from the shared structure it was unlinked from.
+ * @param ptr The pointer to free.
+ * @param free_fn Function freeing it.
+ */
+void hm_epoch_retire(void *ptr, hm_free_fn free_fn)
+{
+    hm_epoch_record *r = self_record();
+    if (!r) {
+        hm_epoch_synchronize();
+        free_fn(ptr);
+        return;
+    }
+
+    // Order the unlink that made ptr unreachable before reading the epoch
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint64_t epoch = __atomic_load_n(&hm_global_epoch, __ATOMIC_ACQUIRE);
+    hm_limbo *limbo = &r->limbo[epoch % 3];
+    if (limbo->epoch != epoch) {
+        // The slot holds pointers from epoch - 3 or earlier
+        limbo_free(limbo);
+        limbo->epoch = epoch;
+    }
+
+    if (limbo->count == limbo->capacity) {
+        size_t capacity = limbo->capacity ? limbo->capacity * 2 : HM_EPOCH_ADVANCE_EVERY;
+        hm_retired *items = realloc(limbo->items, capacity * sizeof(hm_retired));
+        if (!items) {
+            if (r->nesting) {
+                fprintf(stderr, "Error: Failed to retire pointer inside a critical section, leaking it.\n");
+                return;
+            }
+            hm_epoch_synchronize();
+            free_fn(ptr);
+            return;
+        }
+        limbo->items = items;
+        limbo->capacity = capacity;
+    }
+    limbo->items[limbo->count++] = (hm_retired){ ptr, free_fn };
+
+    if (++r->retired_since_advance >= HM_EPOCH_ADVANCE_EVERY) {
+        r->retired_since_advance = 0;
+        try_advance();
+        collect(r, __atomic_load_n(&hm_global_epoch, __ATOMIC_ACQUIRE));
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Epoch-based reclamation, shared by every map in the process.
+//
+// A reader brackets its accesses to shared nodes with hm_epoch_enter/hm_epoch_exit.
+// A writer that unlinks a node hands it to hm_epoch_retire instead of freeing it; the
+// node is freed once every thread that was inside a critical section at that time
+// has left it, so readers never touch freed memory. Critical sections may nest.
+
+// Retired pointers a thread collects before it tries to advance the global epoch
+#define HM_EPOCH_ADVANCE_EVERY 64
+
+// Function that frees a retired pointer
+typedef void (*hm_free_fn)(void *ptr);
+
+// A retired pointer waiting for the readers of its epoch to leave
+typedef struct hm_retired
+{
+    void *ptr;
+    hm_free_fn free_fn;
+} hm_retired;
+
+// Pointers retired during one epoch
+typedef struct hm_limbo
+{
+    uint64_t epoch;      // Epoch the pointers were retired in
+    hm_retired *items;   // Retired pointers
+    size_t count;        // Number of items used
+    size_t capacity;     // Number of items allocated
+} hm_limbo;
+
+// Per-thread state. Records are never freed; a record released by an exiting thread
+// is reused, limbo lists included, by the next thread that needs one.
+typedef struct hm_epoch_record
+{
+    _Alignas(64) uint64_t state;  // (epoch << 1) | 1 while inside a critical section, else 0
+    unsigned nesting;             // Depth of nested critical sections
+    bool in_use;                  // Owned by a live thread
+    size_t retired_since_advance; // Pointers retired since the last attempt to advance
+    hm_limbo limbo[3];            // Pointers retired in the last three epochs
+    struct hm_epoch_record *next; // Next record in the global list
+} hm_epoch_record;
+
+// Function declarations
+bool hm_epoch_enter(void);                          // Enters a critical section; false if no record could be allocated
+void hm_epoch_exit(void);                           // Leaves a critical section
+void hm_epoch_retire(void *ptr, hm_free_fn free_fn); // Frees ptr once no reader can still hold it
+void hm_epoch_synchronize(void);                    // Waits until everything retired so far can be freed
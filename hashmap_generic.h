@@ -0,0 +1,258 @@
+#pragma once
+
+#include "hashmap.h"
+
+// Type-generic maps.
+//
+// HASHMAP_DEFINE(name, KeyT, ValT, hash_fn, eq_fn) defines a map type `name` whose
+// keys and values are stored by value in a flat slot array, with the control bytes
+// and probing of the swiss engine. Every function is static inline and calls
+// hash_fn and eq_fn directly, so the compiler can inline both.
+//
+//   hash_fn: uint64_t hash_fn(KeyT key). Must spread the key over all 64 bits, since
+//            the high bits pick the group and the low 7 bits are stored as a tag.
+//            Hashes are not cached, so a rehash calls hash_fn again for every key.
+//   eq_fn:   bool eq_fn(KeyT a, KeyT b).
+//
+// Keys and values are copied in and out as is; if KeyT is a pointer, the map stores
+// the pointer, not what it points to.
+//
+// Generated API, for a map type `name`:
+//   name*         c_##name(int size)
+//   void          d_##name(name *map)
+//   HashMapStatus name##_put(name *map, KeyT key, ValT value)
+//   HashMapStatus name##_get(const name *map, KeyT key, ValT *value)
+//   ValT*         name##_find(name *map, KeyT key)      (NULL if absent; valid until the next put)
+//   bool          name##_contains(const name *map, KeyT key)
+//   HashMapStatus name##_delete(name *map, KeyT key)
+//   HashMapStatus name##_reserve(name *map, size_t n_entries)
+//
+// Example:
+//   static inline uint64_t point_hash(point p) { return hm_mix64((uint64_t)p.x << 32 | (uint32_t)p.y); }
+//   static inline bool point_eq(point a, point b) { return a.x == b.x && a.y == b.y; }
+//   HASHMAP_DEFINE(pointmap, point, double, point_hash, point_eq)
+
+#define HASHMAP_DEFINE(name, KeyT, ValT, hash_fn, eq_fn)                                        \
+                                                                                                \
+typedef struct name##_slot                                                                      \
+{                                                                                               \
+    KeyT key;                                                                                   \
+    ValT value;                                                                                 \
+} name##_slot;                                                                                  \
+                                                                                                \
+typedef struct name                                                                             \
+{                                                                                               \
+    int size;            /* Number of slots (a power of two, at least HM_GROUP_WIDTH) */        \
+    int count;           /* Number of key-value pairs */                                        \
+    int growth_left;     /* Inserts into EMPTY slots allowed before the next rehash */          \
+    int8_t *ctrl;        /* One control byte per slot */                                        \
+    name##_slot *slots;  /* Flat slot storage, parallel to ctrl */                              \
+} name;                                                                                         \
+                                                                                                \
+/* Returns the slot holding key, or -1 */                                                       \
+static inline int name##_find_index(const name *map, KeyT key, uint64_t h)                      \
+{                                                                                               \
+    int groupMask = map->size / HM_GROUP_WIDTH - 1;                                             \
+    int group = (int)(HM_H1(h) & (uint64_t)groupMask);                                          \
+    int8_t tag = HM_H2(h);                                                                      \
+                                                                                                \
+    for (int step = 1; ; step++) {                                                              \
+        const int8_t *ctrl = map->ctrl + (size_t)group * HM_GROUP_WIDTH;                        \
+        for (uint32_t match = hm_group_match(ctrl, tag); match; match &= match - 1) {           \
+            int index = group * HM_GROUP_WIDTH + __builtin_ctz(match);                          \
+            if (eq_fn(map->slots[index].key, key)) {                                            \
+                return index;                                                                   \
+            }                                                                                   \
+        }                                                                                       \
+        if (hm_group_match(ctrl, HM_CTRL_EMPTY)) {                                              \
+            return -1;                                                                          \
+        }                                                                                       \
+        group = (group + step) & groupMask;                                                     \
+    }                                                                                           \
+}                                                                                               \
+                                                                                                \
+/* Moves every live slot into new arrays of newCapacity slots, dropping tombstones */           \
+static inline HashMapStatus name##_rehash(name *map, int newCapacity)                           \
+{                                                                                               \
+    int8_t *newCtrl = malloc((size_t)newCapacity);                                              \
+    name##_slot *newSlots = malloc((size_t)newCapacity * sizeof(name##_slot));                  \
+    if (!newCtrl || !newSlots) {                                                                \
+        free(newCtrl);                                                                          \
+        free(newSlots);                                                                         \
+        fprintf(stderr, "Error: Failed to allocate memory for new slots during resize.\n");     \
+        return HM_ERR_MALLOC_FAILED;                                                            \
+    }                                                                                           \
+    memset(newCtrl, HM_CTRL_EMPTY, (size_t)newCapacity);                                        \
+                                                                                                \
+    for (int i = 0; i < map->size; i++) {                                                       \
+        if (map->ctrl[i] < 0) {                                                                 \
+            continue; /* EMPTY or DELETED */                                                    \
+        }                                                                                       \
+        uint64_t h = hash_fn(map->slots[i].key);                                                \
+        int index = hm_find_free(newCtrl, newCapacity, h);                                      \
+        newCtrl[index] = HM_H2(h);                                                              \
+        newSlots[index] = map->slots[i];                                                        \
+    }                                                                                           \
+                                                                                                \
+    free(map->ctrl);                                                                            \
+    free(map->slots);                                                                           \
+    map->ctrl = newCtrl;                                                                        \
+    map->slots = newSlots;                                                                      \
+    map->size = newCapacity;                                                                    \
+    map->growth_left = hm_growth_cap(newCapacity) - map->count;                                 \
+    return HM_SUCCESS;                                                                          \
+}                                                                                               \
+                                                                                                \
+/* Creates a map with room for at least size slots */                                           \
+static inline name* c_##name(int size)                                                          \
+{                                                                                               \
+    if (size <= 0 || size > (INT32_MAX >> 1) + 1) {                                             \
+        fprintf(stderr, "Error: Hashmap size must be positive and not too large.\n");           \
+        return NULL;                                                                            \
+    }                                                                                           \
+    int capacity = HM_GROUP_WIDTH;                                                              \
+    while (capacity < size) {                                                                   \
+        capacity <<= 1;                                                                         \
+    }                                                                                           \
+                                                                                                \
+    name *map = calloc(1, sizeof(name));                                                        \
+    if (!map) {                                                                                 \
+        perror("Error: Failed to allocate memory for hashmap");                                 \
+        return NULL;                                                                            \
+    }                                                                                           \
+    if (name##_rehash(map, capacity) != HM_SUCCESS) {                                           \
+        free(map);                                                                              \
+        return NULL;                                                                            \
+    }                                                                                           \
+    return map;                                                                                 \
+}                                                                                               \
+                                                                                                \
+/* Frees the map; keys and values need no cleanup since they are stored by value */             \
+static inline void d_##name(name *map)                                                          \
+{                                                                                               \
+    if (!map) {                                                                                 \
+        return;                                                                                 \
+    }                                                                                           \
+    free(map->ctrl);                                                                            \
+    free(map->slots);                                                                           \
+    free(map);                                                                                  \
+}                                                                                               \
+                                                                                                \
+/* Grows the map so that it holds n_entries without rehashing; never shrinks it */             \
+static inline HashMapStatus name##_reserve(name *map, size_t n_entries)                         \
+{                                                                                               \
+    if (!map) {                                                                                 \
+        fprintf(stderr, "Error: Invalid hashmap provided to " #name "_reserve.\n");             \
+        return HM_ERR_INVALID_ARG;                                                              \
+    }                                                                                           \
+    int capacity = HM_GROUP_WIDTH;                                                              \
+    while ((size_t)hm_growth_cap(capacity) < n_entries) {                                       \
+        if (capacity > INT32_MAX / 2) {                                                         \
+            fprintf(stderr, "Error: Cannot reserve hashmap - size overflow.\n");                \
+            return HM_ERR_SIZE_LIMIT;                                                           \
+        }                                                                                       \
+        capacity <<= 1;                                                                         \
+    }                                                                                           \
+    if (capacity > map->size) {                                                                 \
+        return name##_rehash(map, capacity);                                                    \
+    }                                                                                           \
+    /* Big enough, but tombstones may have used up the inserts left: clear them in place */     \
+    if ((size_t)map->growth_left + (size_t)map->count < n_entries) {                            \
+        return name##_rehash(map, map->size);                                                   \
+    }                                                                                           \
+    return HM_SUCCESS;                                                                          \
+}                                                                                               \
+                                                                                                \
+/* Inserts a key-value pair, or overwrites the value if the key already exists */               \
+static inline HashMapStatus name##_put(name *map, KeyT key, ValT value)                         \
+{                                                                                               \
+    if (!map) {                                                                                 \
+        fprintf(stderr, "Error: Invalid hashmap provided to " #name "_put.\n");                 \
+        return HM_ERR_INVALID_ARG;                                                              \
+    }                                                                                           \
+    uint64_t h = hash_fn(key);                                                                  \
+    int index = name##_find_index(map, key, h);                                                 \
+    if (index >= 0) {                                                                           \
+        map->slots[index].value = value;                                                        \
+        return HM_SUCCESS;                                                                      \
+    }                                                                                           \
+                                                                                                \
+    index = hm_find_free(map->ctrl, map->size, h);                                              \
+    if (map->ctrl[index] == HM_CTRL_EMPTY && map->growth_left == 0) {                           \
+        /* Mostly tombstones: rehash in place, otherwise double */                              \
+        int newCapacity = map->size;                                                            \
+        if (map->count >= hm_growth_cap(map->size) / 2 &&                                       \
+            __builtin_mul_overflow(map->size, 2, &newCapacity)) {                               \
+            fprintf(stderr, "Error: Cannot resize hashmap - size overflow.\n");                 \
+            return HM_ERR_SIZE_LIMIT;                                                           \
+        }                                                                                       \
+        if (name##_rehash(map, newCapacity) != HM_SUCCESS) {                                    \
+            fprintf(stderr, "Warning: Hashmap resize failed during put.\n");                    \
+            return HM_ERR_REHASHING_FAILED;                                                     \
+        }                                                                                       \
+        index = hm_find_free(map->ctrl, map->size, h);                                          \
+    }                                                                                           \
+                                                                                                \
+    if (map->ctrl[index] == HM_CTRL_EMPTY) {                                                    \
+        map->growth_left--;                                                                     \
+    }                                                                                           \
+    map->ctrl[index] = HM_H2(h);                                                                \
+    map->slots[index].key = key;                                                                \
+    map->slots[index].value = value;                                                            \
+    map->count++;                                                                               \
+    return HM_SUCCESS;                                                                          \
+}                                                                                               \
+                                                                                                \
+/* Returns a pointer to the value stored for key, or NULL; valid until the next put */          \
+static inline ValT* name##_find(name *map, KeyT key)                                            \
+{                                                                                               \
+    if (!map) {                                                                                 \
+        return NULL;                                                                            \
+    }                                                                                           \
+    int index = name##_find_index(map, key, hash_fn(key));                                      \
+    return index >= 0 ? &map->slots[index].value : NULL;                                        \
+}                                                                                               \
+                                                                                                \
+/* Copies the value stored for key into *value */                                               \
+static inline HashMapStatus name##_get(const name *map, KeyT key, ValT *value)                  \
+{                                                                                               \
+    if (!map || !value) {                                                                       \
+        fprintf(stderr, "Error: Invalid hashmap or value pointer provided to " #name "_get.\n"); \
+        return HM_ERR_INVALID_ARG;                                                              \
+    }                                                                                           \
+    int index = name##_find_index(map, key, hash_fn(key));                                      \
+    if (index < 0) {                                                                            \
+        return HM_ERR_KEY_NOT_FOUND;                                                            \
+    }                                                                                           \
+    *value = map->slots[index].value;                                                           \
+    return HM_SUCCESS;                                                                          \
+}                                                                                               \
+                                                                                                \
+/* Checks whether key is present */                                                             \
+static inline bool name##_contains(const name *map, KeyT key)                                   \
+{                                                                                               \
+    return map && name##_find_index(map, key, hash_fn(key)) >= 0;                               \
+}                                                                                               \
+                                                                                                \
+/* Removes key and its value */                                                                 \
+static inline HashMapStatus name##_delete(name *map, KeyT key)                                  \
+{                                                                                               \
+    if (!map) {                                                                                 \
+        fprintf(stderr, "Error: Invalid hashmap provided to " #name "_delete.\n");              \
+        return HM_ERR_INVALID_ARG;                                                              \
+    }                                                                                           \
+    int index = name##_find_index(map, key, hash_fn(key));                                      \
+    if (index < 0) {                                                                            \
+        return HM_ERR_KEY_NOT_FOUND;                                                            \
+    }                                                                                           \
+    /* A group that still has an EMPTY slot already stops every probe, so no tombstone */       \
+    int8_t *group = map->ctrl + (size_t)(index / HM_GROUP_WIDTH) * HM_GROUP_WIDTH;              \
+    if (hm_group_match(group, HM_CTRL_EMPTY)) {                                                 \
+        map->ctrl[index] = HM_CTRL_EMPTY;                                                       \
+        map->growth_left++;                                                                     \
+    } else {                                                                                    \
+        map->ctrl[index] = HM_CTRL_DELETED;                                                     \
+    }                                                                                           \
+    map->count--;                                                                               \
+    return HM_SUCCESS;                                                                          \
+}
@@ -0,0 +1,337 @@
+#pragma GCC optimize("O3")
+
+#include "hashmap.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief DJB2 over an explicit length. With a seed of 0 it returns the same value as hash().
+ * @param data The bytes to hash.
+ * @param len The number of bytes.
+ * @param seed Mixed into the initial value.
+ * @return A 64-bit hash value.
+ */
+uint64_t hm_hash_djb2(const void *data, size_t len, uint64_t seed)
+{
+    const unsigned char *bytes = data;
+    uint64_t hash_val = 5381 ^ seed; // DJB2
+
+    for (size_t i = 0; i < len; i++) {
+        // hash * 33 + c
+        hash_val = ((hash_val << 5) + hash_val) + bytes[i];
+    }
+
+    return hash_val;
+}
+
+/* ---------------------------------------------------------------------------
+ * Word-at-a-time hash
+ *
+ * This follows the construction of wyhash (final version 4, public domain):
+ * the key is read 8 bytes at a time and folded with 64x64->128 bit multiplies,
+ * with three independent lanes for keys longer than 48 bytes.
+ * ------------------------------------------------------------------------- */
+
+static const uint64_t wy_secret[4] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+// Multiplies two 64-bit values into a 128-bit product, low half in *a and high half in *b
+static inline void wy_mum(uint64_t *a, uint64_t *b)
+{
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+}
+
+// Folds two 64-bit values into one through their 128-bit product
+static inline uint64_t wy_mix(uint64_t a, uint64_t b)
+{
+    wy_mum(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t wy_read8(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t wy_read4(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Reads 1 to 3 bytes (first, middle and last, possibly overlapping)
+static inline uint64_t wy_read3(const uint8_t *p, size_t k)
+{
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[k >> 1] << 8) | p[k - 1];
+}
+
+/**
+ * @brief Fast 64-bit hash that reads the key a word at a time (wyhash construction).
+ * @param data The bytes to hash.
+ * @param len The number of bytes.
+ * @param seed Selects one of 2^64 different hash functions.
+ * @return A 64-bit hash value with well mixed low and high bits.
+ */
+uint64_t hm_hash_wy(const void *data, size_t len, uint64_t seed)
+{
+    const uint8_t *p = data;
+    uint64_t a, b;
+
+    seed ^= wy_mix(seed ^ wy_secret[0], wy_secret[1]);
+    if (len <= 16) {
+        if (len >= 4) {
+            // Two overlapping 4-byte reads from each end cover every length from 4 to 16
+            a = (wy_read4(p) << 32) | wy_read4(p + ((len >> 3) << 2));
+            b = (wy_read4(p + len - 4) << 32) | wy_read4(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = wy_read3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = wy_mix(wy_read8(p) ^ wy_secret[1], wy_read8(p + 8) ^ seed);
+                see1 = wy_mix(wy_read8(p + 16) ^ wy_secret[2], wy_read8(p + 24) ^ see1);
+                see2 = wy_mix(wy_read8(p + 32) ^ wy_secret[3], wy_read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = wy_mix(wy_read8(p) ^ wy_secret[1], wy_read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        // The last 16 bytes, overlapping what was already consumed if needed
+        a = wy_read8(p + i - 16);
+        b = wy_read8(p + i - 8);
+    }
+
+    a ^= wy_secret[1];
+    b ^= seed;
+    wy_mum(&a, &b);
+    return wy_mix(a ^ wy_secret[0] ^ len, b ^ wy_secret[1]);
+}
+
+/* ---------------------------------------------------------------------------
+ * Vectorized hash for long keys
+ *
+ * Keys of at least HM_SIMD_MIN_LEN bytes are consumed in 32-byte stripes by
+ * four 64-bit accumulators (the accumulate step of XXH3): each lane adds the
+ * 32x32->64 bit product of the two halves of (data ^ key) to itself and the
+ * raw data to its neighbour. The lane keys advance every stripe, so swapping
+ * two stripes changes the hash, and the accumulators are scrambled every
+ * HM_SIMD_BLOCK_STRIPES stripes. Every step only needs 32-bit multiplies, so
+ * the scalar, SSE2 and AVX2 kernels compute exactly the same value and the
+ * fastest one can be picked at runtime.
+ * ------------------------------------------------------------------------- */
+
+#define HM_SIMD_STRIPE 32
+#define HM_SIMD_BLOCK_STRIPES 16
+#define HM_SIMD_KEY_STEP 0x9e3779b97f4a7c15ULL
+#define HM_SIMD_PRIME32 0x9e3779b1U
+
+// Processes whole stripes, updating the accumulators and lane keys in place
+typedef void (*simd_kernel_fn)(uint64_t acc[4], uint64_t key[4], const uint8_t *p, size_t stripes);
+
+/**
+ * @brief Portable kernel, and the reference the vector kernels must match.
+ */
+static void simd_kernel_scalar(uint64_t acc[4], uint64_t key[4], const uint8_t *p, size_t stripes)
+{
+    for (size_t s = 0; s < stripes; s++, p += HM_SIMD_STRIPE) {
+        for (int i = 0; i < 4; i++) {
+            uint64_t d = wy_read8(p + 8 * i);
+            uint64_t dk = d ^ key[i];
+            acc[i ^ 1] += d;
+            acc[i] += (dk & 0xffffffffULL) * (dk >> 32);
+            key[i] += HM_SIMD_KEY_STEP;
+        }
+        if ((s + 1) % HM_SIMD_BLOCK_STRIPES == 0) {
+            for (int i = 0; i < 4; i++) {
+                acc[i] = (acc[i] ^ (acc[i] >> 47)) * HM_SIMD_PRIME32;
+            }
+        }
+    }
+}
+
+#ifdef __SSE2__
+/**
+ * @brief SSE2 kernel: a stripe is two 16-byte registers of two lanes each.
+ */
+static void simd_kernel_sse2(uint64_t acc[4], uint64_t key[4], const uint8_t *p, size_t stripes)
+{
+    __m128i acc0 = _mm_loadu_si128((const __m128i *)acc);
+    __m128i acc1 = _mm_loadu_si128((const __m128i *)(acc + 2));
+    __m128i key0 = _mm_loadu_si128((const __m128i *)key);
+    __m128i key1 = _mm_loadu_si128((const __m128i *)(key + 2));
+    const __m128i step = _mm_set1_epi64x((long long)HM_SIMD_KEY_STEP);
+    const __m128i prime = _mm_set1_epi32((int)HM_SIMD_PRIME32);
+
+    for (size_t s = 0; s < stripes; s++, p += HM_SIMD_STRIPE) {
+        __m128i d0 = _mm_loadu_si128((const __m128i *)p);
+        __m128i d1 = _mm_loadu_si128((const __m128i *)(p + 16));
+        __m128i dk0 = _mm_xor_si128(d0, key0);
+        __m128i dk1 = _mm_xor_si128(d1, key1);
+        // Swapping the two 64-bit lanes adds each lane's data to its neighbour
+        acc0 = _mm_add_epi64(acc0, _mm_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc1 = _mm_add_epi64(acc1, _mm_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc0 = _mm_add_epi64(acc0, _mm_mul_epu32(dk0, _mm_srli_epi64(dk0, 32)));
+        acc1 = _mm_add_epi64(acc1, _mm_mul_epu32(dk1, _mm_srli_epi64(dk1, 32)));
+        key0 = _mm_add_epi64(key0, step);
+        key1 = _mm_add_epi64(key1, step);
+
+        if ((s + 1) % HM_SIMD_BLOCK_STRIPES == 0) {
+            // acc * prime as lo32 * prime + (hi32 * prime) << 32
+            acc0 = _mm_xor_si128(acc0, _mm_srli_epi64(acc0, 47));
+            acc1 = _mm_xor_si128(acc1, _mm_srli_epi64(acc1, 47));
+            acc0 = _mm_add_epi64(_mm_mul_epu32(acc0, prime),
+                                 _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(acc0, 32), prime), 32));
+            acc1 = _mm_add_epi64(_mm_mul_epu32(acc1, prime),
+                                 _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(acc1, 32), prime), 32));
+        }
+    }
+
+    _mm_storeu_si128((__m128i *)acc, acc0);
+    _mm_storeu_si128((__m128i *)(acc + 2), acc1);
+    _mm_storeu_si128((__m128i *)key, key0);
+    _mm_storeu_si128((__m128i *)(key + 2), key1);
+}
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * @brief AVX2 kernel: a whole stripe fits in one 32-byte register.
+ */
+__attribute__((target("avx2")))
+static void simd_kernel_avx2(uint64_t acc[4], uint64_t key[4], const uint8_t *p, size_t stripes)
+{
+    __m256i vacc = _mm256_loadu_si256((const __m256i *)acc);
+    __m256i vkey = _mm256_loadu_si256((const __m256i *)key);
+    const __m256i step = _mm256_set1_epi64x((long long)HM_SIMD_KEY_STEP);
+    const __m256i prime = _mm256_set1_epi32((int)HM_SIMD_PRIME32);
+
+    for (size_t s = 0; s < stripes; s++, p += HM_SIMD_STRIPE) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)p);
+        __m256i dk = _mm256_xor_si256(d, vkey);
+        vacc = _mm256_add_epi64(vacc, _mm256_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+        vacc = _mm256_add_epi64(vacc, _mm256_mul_epu32(dk, _mm256_srli_epi64(dk, 32)));
+        vkey = _mm256_add_epi64(vkey, step);
+
+        if ((s + 1) % HM_SIMD_BLOCK_STRIPES == 0) {
+            vacc = _mm256_xor_si256(vacc, _mm256_srli_epi64(vacc, 47));
+            vacc = _mm256_add_epi64(_mm256_mul_epu32(vacc, prime),
+                                    _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(vacc, 32), prime), 32));
+        }
+    }
+
+    _mm256_storeu_si256((__m256i *)acc, vacc);
+    _mm256_storeu_si256((__m256i *)key, vkey);
+}
+#endif
+
+/**
+ * @brief Picks the widest kernel the CPU supports.
+ * @param name Output for the kernel name, or NULL.
+ * @return The kernel.
+ */
+static simd_kernel_fn simd_select(const char **name)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        if (name) {
+            *name = "avx2";
+        }
+        return simd_kernel_avx2;
+    }
+#endif
+#ifdef __SSE2__
+    if (name) {
+        *name = "sse2";
+    }
+    return simd_kernel_sse2;
+#else
+    if (name) {
+        *name = "scalar";
+    }
+    return simd_kernel_scalar;
+#endif
+}
+
+// Kernel picked on first use; every candidate returns the same value, so racing initializers are harmless
+static simd_kernel_fn simd_kernel;
+
+/**
+ * @brief Hashes a key of at least HM_SIMD_MIN_LEN bytes with a given kernel.
+ */
+static uint64_t simd_hash_long(const uint8_t *p, size_t len, uint64_t seed, simd_kernel_fn kernel)
+{
+    uint64_t acc[4] = { wy_secret[0], wy_secret[1], wy_secret[2], wy_secret[3] };
+    uint64_t key[4] = { wy_secret[1] ^ seed, wy_secret[2] ^ seed, wy_secret[3] ^ seed, wy_secret[0] ^ seed };
+
+    // All whole stripes but the last, then the final 32 bytes (possibly overlapping the previous stripe)
+    size_t stripes = (len - 1) / HM_SIMD_STRIPE;
+    kernel(acc, key, p, stripes);
+    simd_kernel_scalar(acc, key, p + len - HM_SIMD_STRIPE, 1);
+
+    uint64_t h = wy_mix(acc[0] ^ wy_secret[0], acc[1] ^ wy_secret[1])
+               ^ wy_mix(acc[2] ^ wy_secret[2], acc[3] ^ wy_secret[3]);
+    return wy_mix(h ^ len, seed ^ wy_secret[0]);
+}
+
+/**
+ * @brief Hash for long keys using the widest SIMD kernel the CPU supports.
+ * Keys shorter than HM_SIMD_MIN_LEN are passed on to hm_hash_wy.
+ * @param data The bytes to hash.
+ * @param len The number of bytes.
+ * @param seed Selects one of 2^64 different hash functions.
+ * @return A 64-bit hash value, identical whichever kernel computed it.
+ */
+uint64_t hm_hash_simd(const void *data, size_t len, uint64_t seed)
+{
+    if (len < HM_SIMD_MIN_LEN) {
+        return hm_hash_wy(data, len, seed);
+    }
+    simd_kernel_fn kernel = __atomic_load_n(&simd_kernel, __ATOMIC_RELAXED);
+    if (!kernel) {
+        kernel = simd_select(NULL);
+        __atomic_store_n(&simd_kernel, kernel, __ATOMIC_RELAXED);
+    }
+    return simd_hash_long(data, len, seed, kernel);
+}
+
+/**
+ * @brief hm_hash_simd restricted to the portable kernel, for comparing against the vector kernels.
+ */
+uint64_t hm_hash_simd_scalar(const void *data, size_t len, uint64_t seed)
+{
+    if (len < HM_SIMD_MIN_LEN) {
+        return hm_hash_wy(data, len, seed);
+    }
+    return simd_hash_long(data, len, seed, simd_kernel_scalar);
+}
+
+/**
+ * @brief Names the kernel hm_hash_simd uses on this CPU.
+ * @return "avx2", "sse2" or "scalar".
+ */
+const char* hm_hash_simd_kernel(void)
+{
+    const char *name;
+    simd_select(&name);
+    return name;
+}
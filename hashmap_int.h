@@ -0,0 +1,34 @@
+#pragma once
+
+#include "hashmap_generic.h"
+
+// Integer-key maps, generated with HASHMAP_DEFINE. Keys live in the flat slot array
+// next to their values, so an entry needs no allocation of its own, and lookups
+// hash and compare the integer directly instead of formatting it into a string.
+//
+//   u64map: uint64_t keys, int values (c_u64map, u64map_put, u64map_get, ...)
+//   u32map: uint32_t keys, int values (c_u32map, u32map_put, u32map_get, ...)
+
+// Hashes an integer key with the murmur3 finalizer, which spreads it over all 64 bits
+static inline uint64_t hm_hash_u64(uint64_t key)
+{
+    return hm_mix64(key);
+}
+
+static inline uint64_t hm_hash_u32(uint32_t key)
+{
+    return hm_mix64(key);
+}
+
+static inline bool hm_eq_u64(uint64_t a, uint64_t b)
+{
+    return a == b;
+}
+
+static inline bool hm_eq_u32(uint32_t a, uint32_t b)
+{
+    return a == b;
+}
+
+HASHMAP_DEFINE(u64map, uint64_t, int, hm_hash_u64, hm_eq_u64)
+HASHMAP_DEFINE(u32map, uint32_t, int, hm_hash_u32, hm_eq_u32)
@@ -0,0 +1,216 @@
+#pragma GCC optimize("O3")
+
+#include "hashmap_intern.h"
+
+// Probe key of the pool's set: the bytes being looked up, or those of an interned symbol
+typedef struct hm_intern_key
+{
+    const char *str;
+    uint32_t len;
+    uint64_t hash;
+} hm_intern_key;
+
+static inline uint64_t intern_key_hash(hm_intern_key key)
+{
+    return key.hash;
+}
+
+static inline bool intern_key_eq(hm_intern_key a, hm_intern_key b)
+{
+    return a.hash == b.hash && a.len == b.len && memcmp(a.str, b.str, a.len) == 0;
+}
+
+HASHMAP_DEFINE(hm_intern_set, hm_intern_key, hm_symbol, intern_key_hash, intern_key_eq)
+
+/**
+ * @brief Hands out memory for one hm_sym record from the pool's slabs, adding a slab when needed.
+ * Strings too long for a regular slab get a slab of their own.
+ * @param pool A pointer to the pool.
+ * @param size The number of bytes needed.
+ * @return The memory, aligned for hm_sym, or NULL if memory allocation fails.
+ */
+static void* intern_carve(hm_intern_pool* pool, size_t size)
+{
+    size = (size + _Alignof(hm_sym) - 1) & ~(size_t)(_Alignof(hm_sym) - 1);
+    hm_slab* slab = pool->slabs;
+    if (!slab || slab->cap - slab->used < size) {
+        size_t cap = size > HM_SLAB_SIZE - sizeof(hm_slab) ? size : HM_SLAB_SIZE - sizeof(hm_slab);
+        slab = malloc(sizeof(hm_slab) + cap);
+        if (!slab) {
+            return NULL;
+        }
+        slab->used = 0;
+        slab->cap = cap;
+        // A dedicated slab goes behind the current one, which may still have room
+        if (size > HM_SLAB_SIZE - sizeof(hm_slab) && pool->slabs) {
+            slab->next = pool->slabs->next;
+            pool->slabs->next = slab;
+        } else {
+            slab->next = pool->slabs;
+            pool->slabs = slab;
+        }
+    }
+    void *p = slab->data + slab->used;
+    slab->used += size;
+    return p;
+}
+
+/**
+ * @brief Creates an empty string pool.
+ * @param hash_fn Hash function for the strings, or NULL for HM_DEFAULT_HASH.
+ * @param seed Seed passed to hash_fn.
+ * @return A pointer to the pool, or NULL if memory allocation fails.
+ */
+hm_intern_pool* c_intern_pool(hm_hash_fn hash_fn, uint64_t seed)
+{
+    hm_intern_pool* pool = calloc(1, sizeof(hm_intern_pool));
+    if (!pool) {
+        perror("Error: Failed to allocate memory for string pool");
+        return NULL;
+    }
+    pool->set = c_hm_intern_set(HM_GROUP_WIDTH);
+    if (!pool->set) {
+        free(pool);
+        return NULL;
+    }
+    pool->hash_fn = hash_fn ? hash_fn : HM_DEFAULT_HASH;
+    pool->seed = seed;
+    return pool;
+}
+
+/**
+ * @brief Builds the probe key for some bytes.
+ */
+static inline hm_intern_key intern_key(const hm_intern_pool* pool, const void *str, size_t len)
+{
+    if (!str) {
+        str = ""; // Zero bytes, so that hash_fn and memcmp never see NULL
+    }
+    // Mixed once here, so symbols can be used as keys of generic maps as they are
+    return (hm_intern_key){ str, (uint32_t)len, hm_mix64(pool->hash_fn(str, len, pool->seed)) };
+}
+
+/**
+ * @brief Returns the symbol for len bytes, interning a copy of them if they are new.
+ * @param pool A pointer to the pool.
+ * @param str The bytes; may contain NUL bytes.
+ * @param len The number of bytes.
+ * @return The symbol, or NULL if the arguments are invalid or memory allocation fails.
+ */
+hm_symbol hm_intern_n(hm_intern_pool* pool, const void *str, size_t len)
+{
+    // Validate inputs
+    if (!pool || (!str && len)) {
+        fprintf(stderr, "Error: Invalid pool or string provided to hm_intern_n.\n");
+        return NULL;
+    }
+    if (len >= UINT32_MAX) {
+        fprintf(stderr, "Error: String is too long to intern.\n");
+        return NULL;
+    }
+
+    hm_intern_key key = intern_key(pool, str, len);
+    hm_symbol *found = hm_intern_set_find(pool->set, key);
+    if (found) {
+        return *found;
+    }
+
+    hm_sym* sym = intern_carve(pool, sizeof(hm_sym) + len + 1);
+    if (!sym) {
+        perror("Error: Failed to allocate memory for interned string");
+        return NULL;
+    }
+    sym->hash = key.hash;
+    sym->len = (uint32_t)len;
+    memcpy(sym->str, key.str, len);
+    sym->str[len] = '\0';
+
+    // The set keeps pointing at the pool's copy, not at the caller's bytes
+    key.str = sym->str;
+    if (hm_intern_set_put(pool->set, key, sym) != HM_SUCCESS) {
+        return NULL; // The record stays carved but unused until the pool is destroyed
+    }
+    pool->bytes += len;
+    return sym;
+}
+
+/**
+ * @brief Returns the symbol for a string, interning a copy of it if it is new.
+ * @param pool A pointer to the pool.
+ * @param str The NUL-terminated string.
+ * @return The symbol, or NULL if the arguments are invalid or memory allocation fails.
+ */
+hm_symbol hm_intern(hm_intern_pool* pool, const char *str)
+{
+    if (!str) {
+        fprintf(stderr, "Error: Invalid string provided to hm_intern.\n");
+        return NULL;
+    }
+    return hm_intern_n(pool, str, strlen(str));
+}
+
+/**
+ * @brief Returns the symbol for len bytes if they have been interned, without interning them.
+ * A string that was never interned cannot be a key of any symmap, so callers can use this
+ * to answer a lookup by string without growing the pool.
+ * @param pool A constant pointer to the pool.
+ * @param str The bytes.
+ * @param len The number of bytes.
+ * @return The symbol, or NULL if the bytes were never interned or the arguments are invalid.
+ */
+hm_symbol hm_intern_lookup_n(const hm_intern_pool* pool, const void *str, size_t len)
+{
+    // Validate inputs
+    if (!pool || (!str && len) || len >= UINT32_MAX) {
+        fprintf(stderr, "Error: Invalid pool or string provided to hm_intern_lookup_n.\n");
+        return NULL;
+    }
+    hm_symbol sym;
+    return hm_intern_set_get(pool->set, intern_key(pool, str, len), &sym) == HM_SUCCESS ? sym : NULL;
+}
+
+/**
+ * @brief Returns the symbol for a string if it has been interned, without interning it.
+ * @param pool A constant pointer to the pool.
+ * @param str The NUL-terminated string.
+ * @return The symbol, or NULL if the string was never interned or the arguments are invalid.
+ */
+hm_symbol hm_intern_lookup(const hm_intern_pool* pool, const char *str)
+{
+    if (!str) {
+        fprintf(stderr, "Error: Invalid string provided to hm_intern_lookup.\n");
+        return NULL;
+    }
+    return hm_intern_lookup_n(pool, str, strlen(str));
+}
+
+/**
+ * @brief Returns the number of distinct strings in the pool.
+ * @param pool A constant pointer to the pool.
+ * @return The number of symbols, or 0 if pool is NULL.
+ */
+int hm_intern_count(const hm_intern_pool* pool)
+{
+    return pool ? pool->set->count : 0;
+}
+
+/**
+ * @brief Frees the pool and every string interned in it. All of its symbols become invalid,
+ * so maps keyed by them must not be used afterwards.
+ * @param pool A pointer to the pool to be deallocated.
+ */
+void d_intern_pool(hm_intern_pool* pool)
+{
+    if (!pool) {
+        return; // Nothing to free if pool is NULL
+    }
+
+    d_hm_intern_set(pool->set);
+    hm_slab* slab = pool->slabs;
+    while (slab) {
+        hm_slab* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    free(pool);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "hashmap_generic.h"
+
+// Interned strings. A pool keeps one copy of every distinct string it is given and
+// hands out a symbol for it: a stable pointer to that copy together with its length
+// and hash. Interning the same bytes twice returns the same symbol, so symbols from
+// one pool are compared with == and never need the bytes again. Symbols stay valid
+// until the pool is destroyed; strings are never removed individually.
+//
+// A pool is not thread-safe, like hashmap.
+
+// An interned string
+typedef struct hm_sym
+{
+    uint64_t hash;  // Mixed hash of the bytes, computed once when interned
+    uint32_t len;   // Length of the string
+    char str[];     // The bytes, NUL-terminated
+} hm_sym;
+
+// Handle to an interned string
+typedef const hm_sym *hm_symbol;
+
+// Structure to represent a string pool
+typedef struct hm_intern_pool
+{
+    struct hm_intern_set *set;  // Interned strings by content
+    hm_slab *slabs;             // Storage for the hm_sym records, newest first
+    hm_hash_fn hash_fn;         // Hash function for the bytes
+    uint64_t seed;              // Seed passed to hash_fn
+    size_t bytes;               // Bytes of strings interned, NULs excluded
+} hm_intern_pool;
+
+static inline const char* hm_symbol_str(hm_symbol sym)
+{
+    return sym->str;
+}
+
+static inline size_t hm_symbol_len(hm_symbol sym)
+{
+    return sym->len;
+}
+
+// Precomputed hash of a symbol, already mixed, so it can feed HASHMAP_DEFINE directly
+static inline uint64_t hm_symbol_hash(hm_symbol sym)
+{
+    return sym->hash;
+}
+
+// Symbols of the same pool are equal exactly when they are the same pointer
+static inline bool hm_symbol_eq(hm_symbol a, hm_symbol b)
+{
+    return a == b;
+}
+
+// Map from symbols to ints: keys are handles, so a lookup never touches the key bytes
+// and the map owns no key memory (symmap_put, symmap_get, ... as generated by HASHMAP_DEFINE)
+HASHMAP_DEFINE(symmap, hm_symbol, int, hm_symbol_hash, hm_symbol_eq)
+
+// Function declarations
+hm_intern_pool* c_intern_pool(hm_hash_fn hash_fn, uint64_t seed);                  // Creates a string pool
+hm_symbol hm_intern(hm_intern_pool* pool, const char *str);                        // Interns a string
+hm_symbol hm_intern_n(hm_intern_pool* pool, const void *str, size_t len);          // Interns len bytes
+hm_symbol hm_intern_lookup(const hm_intern_pool* pool, const char *str);           // Symbol of a string if already interned
+hm_symbol hm_intern_lookup_n(const hm_intern_pool* pool, const void *str, size_t len); // Same for len bytes
+int hm_intern_count(const hm_intern_pool* pool);                                   // Number of distinct strings
+void d_intern_pool(hm_intern_pool* pool);                                          // Frees the pool and every symbol
@@ -0,0 +1,244 @@
+#pragma GCC optimize("O3")
+
+#include "hashmap_sharded.h"
+
+#include <unistd.h>
+
+/**
+ * @brief Returns the shard a key belongs to, given the key's hash_fn hash. The shards hash
+ * with the same function and seed, so the same hash is handed on to the shard's map.
+ */
+static inline hm_shard* shd_shard_of(const shashmap* map, uint64_t hash)
+{
+    if (map->shard_bits == 0) {
+        return map->shards;
+    }
+    // Mixed, since the high bits of a DJB2 hash of a short key barely change
+    return &map->shards[hm_mix64(hash) >> (64 - map->shard_bits)];
+}
+
+/**
+ * @brief Creates and initializes a new sharded hashmap.
+ * @param size The desired total number of buckets, spread evenly over the shards.
+ * @param shards The desired number of shards (rounded up to a power of two), or 0 for
+ *               SHD_SHARDS_PER_CPU per online CPU.
+ * @param opts Options every shard is created with, or NULL for the defaults.
+ * @return A pointer to the newly created map, or NULL if the arguments are invalid or memory allocation fails.
+ */
+shashmap* c_shashmap(int size, int shards, const hashmap_options *opts)
+{
+    // Validate inputs
+    if (size <= 0 || shards < 0 || shards > (1 << 16)) {
+        fprintf(stderr, "Error: Invalid size or shard count for sharded hashmap.\n");
+        return NULL;
+    }
+    if (shards == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        shards = (cpus > 0 && cpus < (1 << 12) ? (int)cpus : 1) * SHD_SHARDS_PER_CPU;
+    }
+
+    int shardBits = 0;
+    while ((1 << shardBits) < shards) {
+        shardBits++;
+    }
+    int shardCount = 1 << shardBits;
+    int shardSize = (size + shardCount - 1) / shardCount;
+
+    shashmap* map = calloc(1, sizeof(shashmap));
+    if (!map) {
+        perror("Error: Failed to allocate memory for sharded hashmap");
+        return NULL;
+    }
+    map->shard_count = shardCount;
+    map->shard_bits = shardBits;
+    map->hash_fn = opts && opts->hash_fn ? opts->hash_fn : HM_DEFAULT_HASH;
+    map->seed = opts ? opts->seed : 0;
+    map->shards = aligned_alloc(_Alignof(hm_shard), (size_t)shardCount * sizeof(hm_shard));
+    if (!map->shards) {
+        perror("Error: Failed to allocate memory for shards");
+        free(map);
+        return NULL;
+    }
+
+    for (int i = 0; i < shardCount; i++) {
+        hm_shard* shard = &map->shards[i];
+        shard->map = c_hashmap_ex(shardSize, opts);
+        if (!shard->map) {
+            // c_hashmap_ex has already reported why
+            for (int j = 0; j < i; j++) {
+                d_hashmap(map->shards[j].map);
+                pthread_mutex_destroy(&map->shards[j].lock);
+            }
+            free(map->shards);
+            free(map);
+            return NULL;
+        }
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->puts = shard->gets = shard->deletes = 0;
+    }
+    return map;
+}
+
+/**
+ * @brief Inserts a new key-value pair, or updates the value if the key already exists.
+ * @param map A pointer to the sharded hashmap.
+ * @param key The string key.
+ * @param value The integer value.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus shd_put(shashmap* map, const char *key, int value)
+{
+    // Validate inputs
+    if (!map || !key) {
+        fprintf(stderr, "Error: Invalid hashmap or key provided to shd_put.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    size_t len = strlen(key);
+    uint64_t hash = map->hash_fn(key, len, map->seed);
+    hm_shard* shard = shd_shard_of(map, hash);
+
+    pthread_mutex_lock(&shard->lock);
+    shard->puts++;
+    HashMapStatus status = hm_put_hashed(shard->map, key, len, hash, value);
+    pthread_mutex_unlock(&shard->lock);
+    return status;
+}
+
+/**
+ * @brief Retrieves the value associated with a key.
+ * @param map A pointer to the sharded hashmap.
+ * @param key The string key to search for.
+ * @param value Pointer to store the retrieved value.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus shd_get(shashmap* map, const char *key, int *value)
+{
+    // Validate inputs
+    if (!map || !key || !value) {
+        fprintf(stderr, "Error: Invalid hashmap, key, or value pointer provided to shd_get.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    size_t len = strlen(key);
+    uint64_t hash = map->hash_fn(key, len, map->seed);
+    hm_shard* shard = shd_shard_of(map, hash);
+
+    pthread_mutex_lock(&shard->lock);
+    shard->gets++;
+    HashMapStatus status = hm_get_hashed(shard->map, key, len, hash, value);
+    pthread_mutex_unlock(&shard->lock);
+    return status;
+}
+
+/**
+ * @brief Checks whether a key exists in the sharded hashmap.
+ * @param map A pointer to the sharded hashmap.
+ * @param key The string key to search for.
+ * @return true if the key exists, false if it does not or the arguments are invalid.
+ */
+bool shd_contains(shashmap* map, const char *key)
+{
+    // Validate inputs
+    if (!map || !key) {
+        fprintf(stderr, "Error: Invalid hashmap or key provided to shd_contains.\n");
+        return false;
+    }
+    size_t len = strlen(key);
+    uint64_t hash = map->hash_fn(key, len, map->seed);
+    hm_shard* shard = shd_shard_of(map, hash);
+
+    pthread_mutex_lock(&shard->lock);
+    shard->gets++;
+    bool found = hm_contains_hashed(shard->map, key, len, hash);
+    pthread_mutex_unlock(&shard->lock);
+    return found;
+}
+
+/**
+ * @brief Deletes a key-value pair from the sharded hashmap.
+ * @param map A pointer to the sharded hashmap.
+ * @param key The string key of the pair to delete.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus shd_delete(shashmap* map, const char *key)
+{
+    // Validate inputs
+    if (!map || !key) {
+        fprintf(stderr, "Error: Invalid hashmap or key provided to shd_delete.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    size_t len = strlen(key);
+    uint64_t hash = map->hash_fn(key, len, map->seed);
+    hm_shard* shard = shd_shard_of(map, hash);
+
+    pthread_mutex_lock(&shard->lock);
+    shard->deletes++;
+    HashMapStatus status = hm_delete_hashed(shard->map, key, len, hash);
+    pthread_mutex_unlock(&shard->lock);
+    return status;
+}
+
+/**
+ * @brief Returns the number of pairs over all shards. Shards are counted one after another,
+ * so under concurrent updates the total may never have existed at any single instant.
+ * @param map A pointer to the sharded hashmap.
+ * @return The number of pairs, or 0 if map is NULL.
+ */
+int shd_count(shashmap* map)
+{
+    if (!map) {
+        return 0;
+    }
+    int count = 0;
+    for (int i = 0; i < map->shard_count; i++) {
+        pthread_mutex_lock(&map->shards[i].lock);
+        count += map->shards[i].map->count;
+        pthread_mutex_unlock(&map->shards[i].lock);
+    }
+    return count;
+}
+
+/**
+ * @brief Takes a consistent snapshot of one shard.
+ * @param map A pointer to the sharded hashmap.
+ * @param shard Index of the shard, in [0, shard_count).
+ * @param stats Pointer to store the snapshot.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus shd_shard_stats(shashmap* map, int shard, hm_shard_stats *stats)
+{
+    // Validate inputs
+    if (!map || !stats || shard < 0 || shard >= map->shard_count) {
+        fprintf(stderr, "Error: Invalid hashmap, shard index, or stats pointer provided to shd_shard_stats.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    hm_shard* s = &map->shards[shard];
+
+    pthread_mutex_lock(&s->lock);
+    stats->count = s->map->count;
+    stats->size = s->map->size;
+    stats->load_factor = LOAD_FACTOR(s->map);
+    stats->puts = s->puts;
+    stats->gets = s->gets;
+    stats->deletes = s->deletes;
+    pthread_mutex_unlock(&s->lock);
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Frees all memory associated with the sharded hashmap.
+ * No other thread may use the map during or after this call.
+ * @param map A pointer to the sharded hashmap to be deallocated.
+ */
+void d_shashmap(shashmap* map)
+{
+    if (!map) {
+        return; // Nothing to free if map is NULL
+    }
+
+    for (int i = 0; i < map->shard_count; i++) {
+        d_hashmap(map->shards[i].map);
+        pthread_mutex_destroy(&map->shards[i].lock);
+    }
+    free(map->shards);
+    free(map);
+}
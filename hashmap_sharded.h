@@ -0,0 +1,52 @@
+#pragma once
+
+#include "hashmap.h"
+
+#include <pthread.h>
+
+// Shards per online CPU a sharded map gets when created with shards == 0
+#define SHD_SHARDS_PER_CPU 4
+
+// One shard: an ordinary hashmap behind its own mutex. Each shard starts on its own
+// cache line, so threads working on different shards never share one.
+typedef struct hm_shard
+{
+    _Alignas(64) pthread_mutex_t lock; // Guards map and the counters, which every call updates
+    hashmap *map;                      // The shard's keys
+    uint64_t puts;                     // Calls to shd_put routed here
+    uint64_t gets;                     // Calls to shd_get/shd_contains routed here
+    uint64_t deletes;                  // Calls to shd_delete routed here
+} hm_shard;
+
+// Snapshot of one shard, filled in by shd_shard_stats
+typedef struct hm_shard_stats
+{
+    int count;          // Number of key-value pairs
+    int size;           // Number of buckets (slots for the swiss engine)
+    float load_factor;  // count / size
+    uint64_t puts;      // Calls to shd_put routed to the shard
+    uint64_t gets;      // Calls to shd_get/shd_contains routed to the shard
+    uint64_t deletes;   // Calls to shd_delete routed to the shard
+} hm_shard_stats;
+
+// Structure to represent a thread-safe hashmap made of independent shards.
+// A key's shard is picked by the high bits of its hash, so that the shard's own
+// buckets, picked by the low bits, stay evenly used.
+typedef struct shashmap
+{
+    int shard_count;    // Number of shards (a power of two)
+    int shard_bits;     // log2(shard_count)
+    hm_shard *shards;   // The shards
+    hm_hash_fn hash_fn; // Hash function used for routing (the shards use the same)
+    uint64_t seed;      // Seed passed to hash_fn
+} shashmap;
+
+// Function declarations
+shashmap* c_shashmap(int size, int shards, const hashmap_options *opts); // Creates a sharded hashmap
+HashMapStatus shd_put(shashmap* map, const char *key, int value);      // Inserts or updates a key-value pair
+HashMapStatus shd_get(shashmap* map, const char *key, int *value);     // Retrieves the value associated with a key
+HashMapStatus shd_delete(shashmap* map, const char *key);              // Deletes a key-value pair
+bool shd_contains(shashmap* map, const char *key);                     // Checks if a key exists
+int shd_count(shashmap* map);                                          // Number of pairs over all shards
+HashMapStatus shd_shard_stats(shashmap* map, int shard, hm_shard_stats *stats); // Snapshot of one shard
+void d_shashmap(shashmap* map);                                        // Frees the map; no other thread may be using it
@@ -0,0 +1,432 @@
+#pragma GCC optimize("O3")
+
+#include "hashmap_wal.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Checksum of a record: everything after the checksum field, key included.
+ * @param record The record bytes, followed by its key; need not be aligned.
+ * @param key_len The length of the key.
+ */
+static uint32_t record_checksum(const unsigned char *record, uint32_t key_len)
+{
+    size_t skip = offsetof(hm_wal_record, op);
+    return (uint32_t)hm_hash_wy(record + skip, sizeof(hm_wal_record) - skip + key_len, 0x57414c);
+}
+
+/**
+ * @brief Writes all of a buffer, retrying short writes and interrupted calls.
+ */
+static bool write_all(int fd, const unsigned char *data, size_t len)
+{
+    while (len) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+/**
+ * @brief Puts the log in the failed state after a write or sync error. Whatever part of the
+ * failed write reached the file is cut off, so the next replay sees only complete records.
+ */
+static HashMapStatus wal_fail(hm_wal* wal, const char *message)
+{
+    perror(message);
+    wal->failed = true;
+    wal->used = 0;
+    if (ftruncate(wal->fd, (off_t)wal->file_len) != 0 || lseek(wal->fd, (off_t)wal->file_len, SEEK_SET) < 0) {
+        perror("Error: Failed to cut write-ahead log back to its last complete record");
+    }
+    return HM_ERR_IO;
+}
+
+/**
+ * @brief Returns true, after printing an error, if the log has failed.
+ */
+static bool wal_failed(const hm_wal* wal, const char *fn)
+{
+    if (wal->failed) {
+        fprintf(stderr, "Error: %s called on a write-ahead log that has failed.\n", fn);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Writes the buffered records to the log file, without syncing.
+ */
+static HashMapStatus wal_flush(hm_wal* wal)
+{
+    if (wal->used && !write_all(wal->fd, wal->buf, wal->used)) {
+        return wal_fail(wal, "Error: Failed to write to write-ahead log");
+    }
+    wal->file_len += wal->used;
+    wal->used = 0;
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Writes the buffered records and fsyncs the log, making every logged operation durable.
+ */
+static HashMapStatus wal_commit(hm_wal* wal)
+{
+    HashMapStatus status = wal_flush(wal);
+    if (status != HM_SUCCESS) {
+        return status;
+    }
+    if (wal->pending && fsync(wal->fd) != 0) {
+        return wal_fail(wal, "Error: Failed to sync write-ahead log");
+    }
+    wal->pending = 0;
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Appends a record for an operation already applied to the map, committing the group if it is due.
+ */
+static HashMapStatus wal_append(hm_wal* wal, HashMapWalOp op, const void *key, size_t len, int value)
+{
+    size_t size = sizeof(hm_wal_record) + len;
+    if (wal->used + size > HM_WAL_BUFFER_SIZE) {
+        HashMapStatus status = wal_flush(wal);
+        if (status != HM_SUCCESS) {
+            return status;
+        }
+    }
+
+    hm_wal_record header = { 0, (uint32_t)op, (uint32_t)len, value };
+    if (size > HM_WAL_BUFFER_SIZE) {
+        // Too large for the buffer: build the record on the heap and write it straight out
+        unsigned char *record = malloc(size);
+        if (!record) {
+            perror("Error: Failed to allocate memory for write-ahead log record");
+            return HM_ERR_MALLOC_FAILED;
+        }
+        memcpy(record, &header, sizeof(header));
+        memcpy(record + sizeof(header), key, len);
+        header.checksum = record_checksum(record, header.key_len);
+        memcpy(record, &header.checksum, sizeof(header.checksum));
+        bool written = write_all(wal->fd, record, size);
+        free(record);
+        if (!written) {
+            return wal_fail(wal, "Error: Failed to write to write-ahead log");
+        }
+        wal->file_len += size;
+    } else {
+        // Records are packed, so the header is copied in rather than written through a pointer
+        unsigned char *record = wal->buf + wal->used;
+        memcpy(record, &header, sizeof(header));
+        memcpy(record + sizeof(header), key, len);
+        header.checksum = record_checksum(record, header.key_len);
+        memcpy(record, &header.checksum, sizeof(header.checksum));
+        wal->used += size;
+    }
+
+    if (wal->pending++ == 0) {
+        wal->pending_since_ns = wal->sync_interval_us ? now_ns() : 0;
+    }
+    if (wal->pending >= wal->sync_every ||
+        (wal->sync_interval_us && now_ns() - wal->pending_since_ns >= (uint64_t)wal->sync_interval_us * 1000)) {
+        return wal_commit(wal);
+    }
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Applies the records of an existing log to a map.
+ * @param map The map to replay into.
+ * @param data The log file contents.
+ * @param len The length of data.
+ * @param replayed Incremented per applied record.
+ * @param valid_len Set to the length of the log up to the last complete record.
+ * @return HashMapStatus indicating success or failure type; a torn tail is not an error.
+ */
+static HashMapStatus replay(hashmap* map, const unsigned char *data, size_t len, uint64_t *replayed, size_t *valid_len)
+{
+    const hm_wal_header *header = (const hm_wal_header *)data;
+    if (memcmp(header->magic, HM_WAL_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != HM_WAL_VERSION || header->byte_order != 0x01020304) {
+        fprintf(stderr, "Error: File is not a write-ahead log.\n");
+        return HM_ERR_IO;
+    }
+
+    size_t pos = sizeof(hm_wal_header);
+    while (len - pos >= sizeof(hm_wal_record)) {
+        hm_wal_record record;
+        memcpy(&record, data + pos, sizeof(record));
+        if (record.key_len > len - pos - sizeof(record) ||
+            record_checksum(data + pos, record.key_len) != record.checksum) {
+            break; // Torn by a crash while being written
+        }
+        const unsigned char *key = data + pos + sizeof(record);
+
+        HashMapStatus status = HM_SUCCESS;
+        if (record.op == HM_WAL_PUT) {
+            status = put_n(map, key, record.key_len, record.value);
+            if (status == HM_ERR_REHASHING_FAILED && contains_n(map, key, record.key_len)) {
+                status = HM_SUCCESS; // Applied; the map is just fuller than it likes to be
+            }
+        } else if (record.op == HM_WAL_DELETE) {
+            status = delete_n(map, key, record.key_len);
+            if (status == HM_ERR_KEY_NOT_FOUND) {
+                status = HM_SUCCESS; // The map given to hm_wal_open may not have held it
+            }
+        } else {
+            fprintf(stderr, "Error: Unknown operation in write-ahead log.\n");
+            status = HM_ERR_IO;
+        }
+        if (status != HM_SUCCESS) {
+            return status;
+        }
+        (*replayed)++;
+        pos += sizeof(record) + record.key_len;
+    }
+    *valid_len = pos;
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Opens the log file of a new hm_wal, replays it into wal->map and positions it for appending.
+ * @return HashMapStatus indicating success or failure type.
+ */
+static HashMapStatus open_log(hm_wal* wal, const char *path)
+{
+    wal->fd = open(path, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (wal->fd < 0 || fstat(wal->fd, &st) != 0) {
+        perror("Error: Failed to open write-ahead log");
+        return HM_ERR_IO;
+    }
+
+    size_t validLen = 0;
+    if ((size_t)st.st_size >= sizeof(hm_wal_header)) {
+        void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, wal->fd, 0);
+        if (data == MAP_FAILED) {
+            perror("Error: Failed to map write-ahead log");
+            return HM_ERR_IO;
+        }
+        HashMapStatus status = replay(wal->map, data, (size_t)st.st_size, &wal->replayed, &validLen);
+        munmap(data, (size_t)st.st_size);
+        if (status != HM_SUCCESS) {
+            return status;
+        }
+    } else {
+        // New, or torn while its header was being written
+        hm_wal_header header = { .version = HM_WAL_VERSION, .byte_order = 0x01020304 };
+        memcpy(header.magic, HM_WAL_MAGIC, sizeof(header.magic));
+        if (ftruncate(wal->fd, 0) != 0 || !write_all(wal->fd, (const unsigned char *)&header, sizeof(header))) {
+            perror("Error: Failed to write write-ahead log header");
+            return HM_ERR_IO;
+        }
+        validLen = sizeof(header);
+    }
+
+    // Drop a torn tail so new records follow the last complete one
+    if ((validLen < (size_t)st.st_size && ftruncate(wal->fd, (off_t)validLen) != 0) ||
+        lseek(wal->fd, (off_t)validLen, SEEK_SET) < 0 || fsync(wal->fd) != 0) {
+        perror("Error: Failed to prepare write-ahead log for appending");
+        return HM_ERR_IO;
+    }
+    wal->file_len = validLen;
+    return HM_SUCCESS;
+}
+
+/**
+ * @brief Opens a write-ahead log, creating it if it does not exist. The operations of an existing
+ * log are first applied to map, which normally starts out empty; a record torn by a crash and
+ * anything after it are cut off the log.
+ * @param path The log file.
+ * @param map A pointer to the map the log belongs to. It stays owned by the caller, and must only
+ *            be modified through the hm_wal functions while the log is open.
+ * @param opts Group commit options, or NULL to commit every operation on its own.
+ * @return A pointer to the log, or NULL if the arguments are invalid, the file is not a log,
+ *         replaying fails (map then holds the records before the failure) or memory allocation fails.
+ */
+hm_wal* hm_wal_open(const char *path, hashmap *map, const hm_wal_options *opts)
+{
+    // Validate inputs
+    if (!path || !map || (opts && (opts->sync_every < 0 || opts->sync_interval_us < 0))) {
+        fprintf(stderr, "Error: Invalid path, hashmap or options provided to hm_wal_open.\n");
+        return NULL;
+    }
+    if (map->engine == HM_ENGINE_SNAPSHOT) {
+        fprintf(stderr, "Error: hm_wal_open called on a read-only snapshot map.\n");
+        return NULL;
+    }
+
+    hm_wal* wal = calloc(1, sizeof(hm_wal));
+    if (!wal) {
+        perror("Error: Failed to allocate memory for write-ahead log");
+        return NULL;
+    }
+    wal->buf = malloc(HM_WAL_BUFFER_SIZE);
+    if (!wal->buf) {
+        perror("Error: Failed to allocate memory for write-ahead log buffer");
+        free(wal);
+        return NULL;
+    }
+    wal->map = map;
+    wal->sync_every = opts && opts->sync_every > 1 ? opts->sync_every : 1;
+    wal->sync_interval_us = opts ? opts->sync_interval_us : 0;
+
+    if (open_log(wal, path) != HM_SUCCESS) {
+        if (wal->fd >= 0) {
+            close(wal->fd);
+        }
+        free(wal->buf);
+        free(wal);
+        return NULL;
+    }
+    return wal;
+}
+
+/**
+ * @brief Inserts or updates a key-value pair and logs the operation.
+ * @param wal A pointer to the log.
+ * @param key The key bytes; may contain NUL bytes.
+ * @param len The length of the key.
+ * @param value The integer value.
+ * @return HashMapStatus indicating success or failure type. HM_ERR_IO means the map was updated
+ *         but the operation may not be durable, or that the log had already failed and the map
+ *         was left alone; either way the log refuses every later operation.
+ *         HM_ERR_REHASHING_FAILED is returned as put_n reports it, and the put is logged
+ *         whenever it reached the map.
+ */
+HashMapStatus hm_wal_put_n(hm_wal* wal, const void *key, size_t len, int value)
+{
+    // Validate inputs
+    if (!wal) {
+        fprintf(stderr, "Error: Invalid write-ahead log provided to hm_wal_put_n.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    if (wal_failed(wal, "hm_wal_put_n")) {
+        return HM_ERR_IO;
+    }
+    HashMapStatus status = put_n(wal->map, key, len, value);
+    // A failed resize may come before the insert (swiss) or after it (chained), so ask the map
+    if (status == HM_ERR_REHASHING_FAILED && !contains_n(wal->map, key, len)) {
+        return status;
+    }
+    if (status != HM_SUCCESS && status != HM_ERR_REHASHING_FAILED) {
+        return status;
+    }
+    HashMapStatus logged = wal_append(wal, HM_WAL_PUT, key, len, value);
+    return logged == HM_SUCCESS ? status : logged;
+}
+
+/**
+ * @brief Inserts or updates a key-value pair and logs the operation.
+ * @param wal A pointer to the log.
+ * @param key The string key.
+ * @param value The integer value.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus hm_wal_put(hm_wal* wal, const char *key, int value)
+{
+    if (!key) {
+        fprintf(stderr, "Error: Invalid key provided to hm_wal_put.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    return hm_wal_put_n(wal, key, strlen(key), value);
+}
+
+/**
+ * @brief Deletes a key-value pair and logs the operation. Deleting a missing key logs nothing.
+ * @param wal A pointer to the log.
+ * @param key The key bytes; may contain NUL bytes.
+ * @param len The length of the key.
+ * @return HashMapStatus indicating success or failure type. HM_ERR_IO means the map was updated
+ *         but the operation may not be durable, or that the log had already failed and the map
+ *         was left alone; either way the log refuses every later operation.
+ */
+HashMapStatus hm_wal_delete_n(hm_wal* wal, const void *key, size_t len)
+{
+    // Validate inputs
+    if (!wal) {
+        fprintf(stderr, "Error: Invalid write-ahead log provided to hm_wal_delete_n.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    if (wal_failed(wal, "hm_wal_delete_n")) {
+        return HM_ERR_IO;
+    }
+    HashMapStatus status = delete_n(wal->map, key, len);
+    if (status != HM_SUCCESS) {
+        return status;
+    }
+    return wal_append(wal, HM_WAL_DELETE, key, len, 0);
+}
+
+/**
+ * @brief Deletes a key-value pair and logs the operation.
+ * @param wal A pointer to the log.
+ * @param key The string key of the pair to delete.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus hm_wal_delete(hm_wal* wal, const char *key)
+{
+    if (!key) {
+        fprintf(stderr, "Error: Invalid key provided to hm_wal_delete.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    return hm_wal_delete_n(wal, key, strlen(key));
+}
+
+/**
+ * @brief Commits the current group: every operation logged so far is durable once this returns.
+ * @param wal A pointer to the log.
+ * @return HashMapStatus indicating success or failure type.
+ */
+HashMapStatus hm_wal_sync(hm_wal* wal)
+{
+    if (!wal) {
+        fprintf(stderr, "Error: Invalid write-ahead log provided to hm_wal_sync.\n");
+        return HM_ERR_INVALID_ARG;
+    }
+    if (wal_failed(wal, "hm_wal_sync")) {
+        return HM_ERR_IO;
+    }
+    return wal_commit(wal);
+}
+
+/**
+ * @brief Commits outstanding operations, closes the log file and frees the log. The map is left
+ * to the caller.
+ * @param wal A pointer to the log.
+ * @return HashMapStatus of the final commit, HM_ERR_IO if the log had failed; the log is freed either way.
+ */
+HashMapStatus hm_wal_close(hm_wal* wal)
+{
+    if (!wal) {
+        return HM_SUCCESS; // Nothing to close if wal is NULL
+    }
+    HashMapStatus status = wal->failed ? HM_ERR_IO : wal_commit(wal);
+    if (close(wal->fd) != 0 && status == HM_SUCCESS) {
+        perror("Error: Failed to close write-ahead log");
+        status = HM_ERR_IO;
+    }
+    free(wal->buf);
+    free(wal);
+    return status;
+}
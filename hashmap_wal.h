@@ -0,0 +1,84 @@
+#pragma once
+
+#include "hashmap.h"
+
+// Write-ahead log for a hashmap. Every put and delete_key made through hm_wal_put and
+// hm_wal_delete is appended to a log file, and hm_wal_open replays an existing log into
+// the map, so the map survives a crash or restart. Reads go to the map directly.
+//
+// Records are buffered and fsync'ed in groups (group commit): an operation is durable once
+// its group has been committed, which happens after sync_every operations, once the oldest
+// uncommitted operation is sync_interval_us old (checked on the next operation), on
+// hm_wal_sync and on hm_wal_close. A larger group trades durability latency for throughput;
+// a crash loses at most the uncommitted group.
+//
+// File layout, all integers in host byte order:
+//
+//   hm_wal_header
+//   records: hm_wal_record followed by key_len key bytes
+//
+// Each record carries a checksum, so replay stops at a record torn by a crash and the log
+// is cut back to the last complete record before new ones are appended. The log only
+// grows; rewrite it (e.g. from a snapshot) when it gets too long. Not thread-safe, like hashmap.
+//
+// A failed write or fsync leaves it unknown which buffered records reached the disk, so the
+// log cuts the file back to its last complete record and fails: every later put, delete and
+// sync returns HM_ERR_IO without touching the map. Close it and reopen it to carry on; the
+// reopened map holds what the log holds.
+#define HM_WAL_MAGIC "HMWAL\0\0\1"
+#define HM_WAL_VERSION 1
+// Bytes of records buffered before they are written out even if no commit is due
+#define HM_WAL_BUFFER_SIZE (64 * 1024)
+
+typedef struct hm_wal_header
+{
+    char magic[8];       // HM_WAL_MAGIC
+    uint32_t version;    // HM_WAL_VERSION
+    uint32_t byte_order; // 0x01020304 as written
+} hm_wal_header;
+
+// Operations a record can hold
+typedef enum HashMapWalOp {
+    HM_WAL_PUT = 1,
+    HM_WAL_DELETE,
+} HashMapWalOp;
+
+typedef struct hm_wal_record
+{
+    uint32_t checksum;   // Low 32 bits of hm_hash_wy over the rest of the record, key included
+    uint32_t op;         // HashMapWalOp
+    uint32_t key_len;    // Length of the key bytes that follow
+    int32_t value;       // Value of a put, 0 for a delete
+} hm_wal_record;
+
+// Options for hm_wal_open. A zeroed struct commits every operation on its own.
+typedef struct hm_wal_options
+{
+    int sync_every;       // Operations per group commit; 0 or 1 fsyncs every operation
+    int sync_interval_us; // Also commit once the oldest uncommitted operation is this old; 0 for no limit
+} hm_wal_options;
+
+// Structure to represent a hashmap with a write-ahead log
+typedef struct hm_wal
+{
+    hashmap *map;          // The logged map; owned by the caller
+    int fd;                // The log file, open for appending
+    unsigned char *buf;    // Records not yet written to fd
+    size_t used;           // Bytes of buf filled
+    int sync_every;        // See hm_wal_options
+    int sync_interval_us;  // See hm_wal_options
+    int pending;           // Operations since the last commit
+    uint64_t pending_since_ns; // Monotonic time of the oldest uncommitted operation
+    uint64_t replayed;     // Records applied by hm_wal_open
+    uint64_t file_len;     // Bytes of the log file written in full: the header and complete records
+    bool failed;           // A write or sync failed; the log refuses every later operation
+} hm_wal;
+
+// Function declarations
+hm_wal* hm_wal_open(const char *path, hashmap *map, const hm_wal_options *opts); // Replays the log into map and opens it for appending
+HashMapStatus hm_wal_put(hm_wal* wal, const char *key, int value);              // put, logged
+HashMapStatus hm_wal_put_n(hm_wal* wal, const void *key, size_t len, int value); // put_n, logged
+HashMapStatus hm_wal_delete(hm_wal* wal, const char *key);                      // delete_key, logged
+HashMapStatus hm_wal_delete_n(hm_wal* wal, const void *key, size_t len);        // delete_n, logged
+HashMapStatus hm_wal_sync(hm_wal* wal);                                         // Commits every operation so far
+HashMapStatus hm_wal_close(hm_wal* wal);                                        // Commits, closes the log and frees wal (not the map)
@@ -0,0 +1,124 @@
+// Checks that chashmap lookups, locked or lock-free, stay consistent with concurrent puts,
+// updates, deletes and the resizes they trigger: a key its writer has published is always
+// found, with a value the writer stored, and the final map holds exactly the pairs the
+// writers left.
+// Build: gcc -O1 -pthread -I. tests/concurrent.c hashmap_concurrent.c hashmap_epoch.c hashmap.c hashmap_hash.c -o concurrent_test
+
+#include "hashmap_concurrent.h"
+
+#undef NDEBUG // The asserts are the test, and some of them make the calls being checked
+#include <assert.h>
+
+#define TEST_WRITERS 4
+#define TEST_READERS 4
+#define TEST_KEYS_PER_WRITER 20000
+
+typedef struct test_ctx
+{
+    chashmap *map;
+    int published[TEST_WRITERS]; // Keys below this of each writer are in the map for good
+    int writers_done;
+} test_ctx;
+
+typedef struct test_thread
+{
+    test_ctx *ctx;
+    int id;
+} test_thread;
+
+// A key's value is 2 * its index plus 1 once updated, so any value seen tells which key it
+// belongs to; keys with index % 5 == 4 are deleted again
+static void key_of(int writer, int i, char *key, size_t size)
+{
+    snprintf(key, size, "w%d:%d", writer, i);
+}
+
+static void *writer_main(void *arg)
+{
+    test_thread *t = arg;
+    chashmap *map = t->ctx->map;
+    char key[32];
+    for (int i = 0; i < TEST_KEYS_PER_WRITER; i++) {
+        key_of(t->id, i, key, sizeof(key));
+        assert(chm_put(map, key, 2 * i) == HM_SUCCESS);
+        assert(chm_put(map, key, 2 * i + 1) == HM_SUCCESS);
+        if (i % 5 == 4) {
+            // Deleted keys are never published
+            assert(chm_delete(map, key) == HM_SUCCESS);
+            assert(chm_delete(map, key) == HM_ERR_KEY_NOT_FOUND);
+        } else {
+            __atomic_store_n(&t->ctx->published[t->id], i + 1, __ATOMIC_RELEASE);
+        }
+    }
+    __atomic_add_fetch(&t->ctx->writers_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void *reader_main(void *arg)
+{
+    test_thread *t = arg;
+    chashmap *map = t->ctx->map;
+    char key[32];
+    unsigned rng = 2463534242u + (unsigned)t->id;
+    while (__atomic_load_n(&t->ctx->writers_done, __ATOMIC_ACQUIRE) < TEST_WRITERS) {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        int writer = (int)(rng % TEST_WRITERS);
+        int published = __atomic_load_n(&t->ctx->published[writer], __ATOMIC_ACQUIRE);
+        if (published == 0) {
+            continue;
+        }
+        int i = (int)((rng >> 8) % (unsigned)published);
+        key_of(writer, i, key, sizeof(key));
+        int value;
+        HashMapStatus status = chm_get(map, key, &value);
+        if (i % 5 == 4) {
+            assert(status == HM_ERR_KEY_NOT_FOUND);
+        } else {
+            assert(status == HM_SUCCESS && value == 2 * i + 1);
+            assert(chm_contains(map, key));
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs the writers and readers against a small map, so it resizes many times.
+ */
+static void run(const char *name, const chashmap_options *opts)
+{
+    test_ctx ctx = { .map = c_chashmap_ex(16, opts) };
+    assert(ctx.map);
+    pthread_t threads[TEST_WRITERS + TEST_READERS];
+    test_thread args[TEST_WRITERS + TEST_READERS];
+    for (int i = 0; i < TEST_WRITERS + TEST_READERS; i++) {
+        args[i] = (test_thread){ &ctx, i < TEST_WRITERS ? i : i - TEST_WRITERS };
+        assert(pthread_create(&threads[i], NULL, i < TEST_WRITERS ? writer_main : reader_main, &args[i]) == 0);
+    }
+    for (int i = 0; i < TEST_WRITERS + TEST_READERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    char key[32];
+    for (int w = 0; w < TEST_WRITERS; w++) {
+        for (int i = 0; i < TEST_KEYS_PER_WRITER; i++) {
+            key_of(w, i, key, sizeof(key));
+            int value;
+            HashMapStatus status = chm_get(ctx.map, key, &value);
+            assert(i % 5 == 4 ? status == HM_ERR_KEY_NOT_FOUND : status == HM_SUCCESS && value == 2 * i + 1);
+        }
+    }
+    assert(chm_count(ctx.map) == TEST_WRITERS * (TEST_KEYS_PER_WRITER - TEST_KEYS_PER_WRITER / 5));
+    printf("%s: %d pairs in %d buckets\n", name, chm_count(ctx.map), ctx.map->table->size);
+    d_chashmap(ctx.map);
+}
+
+int main(void)
+{
+    run("locked reads", &(chashmap_options){ .stripes = 4 });
+    // Readers now race the resizes' chain moves and the epoch reclamation of unlinked pairs
+    run("lock-free reads", &(chashmap_options){ .stripes = 4, .lockfree_reads = true });
+    printf("ok\n");
+    return 0;
+}
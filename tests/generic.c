@@ -0,0 +1,137 @@
+// Instantiates HASHMAP_DEFINE with a struct key, and the u64map and u32map integer maps, and
+// checks put/get/find/contains/delete, growth from the smallest size, key 0 and the all-ones
+// key, and that reserve(n) holds n entries without a rehash, also after many deletes.
+// Build: gcc -O1 -I. tests/generic.c hashmap.c hashmap_hash.c -o generic_test
+
+#include "hashmap_int.h"
+
+#undef NDEBUG // The asserts are the test, and some of them make the calls being checked
+#include <assert.h>
+
+typedef struct point
+{
+    int x;
+    int y;
+} point;
+
+static inline uint64_t point_hash(point p)
+{
+    return hm_mix64((uint64_t)(uint32_t)p.x << 32 | (uint32_t)p.y);
+}
+
+static inline bool point_eq(point a, point b)
+{
+    return a.x == b.x && a.y == b.y;
+}
+
+HASHMAP_DEFINE(pointmap, point, double, point_hash, point_eq)
+
+// The same checks for any generated map whose keys are made from an index by MAKE_KEY and
+// whose values are ints or doubles; a macro, since every map is its own type
+#define CHECK_MAP(name, KeyT, MAKE_KEY, n)                                                      \
+    do {                                                                                        \
+        name *map = c_##name(1);                                                                \
+        assert(map && map->size == HM_GROUP_WIDTH);                                             \
+        for (int i = 0; i < (n); i++) {                                                         \
+            assert(name##_put(map, MAKE_KEY(i), i) == HM_SUCCESS);                              \
+        }                                                                                       \
+        assert(map->count == (n));                                                              \
+        for (int i = 0; i < (n); i++) {                                                         \
+            KeyT key = MAKE_KEY(i);                                                             \
+            __typeof__(map->slots[0].value) value;                                              \
+            assert(name##_get(map, key, &value) == HM_SUCCESS && value == i);                   \
+            assert(name##_contains(map, key) && *name##_find(map, key) == i);                   \
+        }                                                                                       \
+        /* Update every key, then delete the odd ones */                                        \
+        for (int i = 0; i < (n); i++) {                                                         \
+            assert(name##_put(map, MAKE_KEY(i), -i) == HM_SUCCESS);                             \
+        }                                                                                       \
+        assert(map->count == (n));                                                              \
+        for (int i = 1; i < (n); i += 2) {                                                      \
+            assert(name##_delete(map, MAKE_KEY(i)) == HM_SUCCESS);                              \
+            assert(name##_delete(map, MAKE_KEY(i)) == HM_ERR_KEY_NOT_FOUND);                    \
+        }                                                                                       \
+        assert(map->count == (n) - (n) / 2);                                                    \
+        for (int i = 0; i < (n); i++) {                                                         \
+            __typeof__(map->slots[0].value) value;                                              \
+            HashMapStatus status = name##_get(map, MAKE_KEY(i), &value);                        \
+            if (i % 2) {                                                                        \
+                assert(status == HM_ERR_KEY_NOT_FOUND && !name##_find(map, MAKE_KEY(i)));       \
+            } else {                                                                            \
+                assert(status == HM_SUCCESS && value == -i && name##_find(map, MAKE_KEY(i)));   \
+            }                                                                                   \
+        }                                                                                       \
+        d_##name(map);                                                                          \
+                                                                                                \
+        /* reserve(n) on a fresh map: n puts, no rehash */                                      \
+        map = c_##name(1);                                                                      \
+        assert(map && name##_reserve(map, (n)) == HM_SUCCESS);                                  \
+        int8_t *ctrl = map->ctrl;                                                               \
+        for (int i = 0; i < (n); i++) {                                                         \
+            assert(name##_put(map, MAKE_KEY(i), i) == HM_SUCCESS);                              \
+        }                                                                                       \
+        assert(map->ctrl == ctrl && map->count == (n));                                         \
+                                                                                                \
+        /* Fill to the growth limit and delete most keys: the freed slots of full groups */     \
+        /* become tombstones. reserve must still make room for n new puts without a rehash */   \
+        int limit = hm_growth_cap(map->size);                                                   \
+        for (int i = (n); i < limit; i++) {                                                     \
+            assert(name##_put(map, MAKE_KEY(i), i) == HM_SUCCESS);                              \
+        }                                                                                       \
+        assert(map->growth_left == 0);                                                          \
+        for (int i = 0; i < limit - (n) / 8; i++) {                                             \
+            assert(name##_delete(map, MAKE_KEY(i)) == HM_SUCCESS);                              \
+        }                                                                                       \
+        assert(map->growth_left + map->count < (n)); /* So the inserts left really are short */ \
+        int size = map->size;                                                                   \
+        assert(name##_reserve(map, (n)) == HM_SUCCESS && map->size == size);                    \
+        assert(map->growth_left + map->count >= (n));                                           \
+        ctrl = map->ctrl;                                                                       \
+        for (int i = 0; i < (n) - (n) / 8; i++) {                                               \
+            assert(name##_put(map, MAKE_KEY(limit + i), i) == HM_SUCCESS);                      \
+        }                                                                                       \
+        assert(map->ctrl == ctrl && map->count == (n));                                         \
+        for (int i = limit - (n) / 8; i < limit; i++) {                                         \
+            assert(name##_contains(map, MAKE_KEY(i)));                                          \
+        }                                                                                       \
+        d_##name(map);                                                                          \
+        printf(#name ": ok\n");                                                                 \
+    } while (0)
+
+#define POINT_KEY(i) ((point){ (i) % 97 - 48, (i) / 97 })
+#define U64_KEY(i) ((uint64_t)(i) * 0x9E3779B97F4A7C15ull)
+#define U32_KEY(i) ((uint32_t)(i) * 2654435761u)
+
+int main(void)
+{
+    CHECK_MAP(pointmap, point, POINT_KEY, 5000);
+    CHECK_MAP(u64map, uint64_t, U64_KEY, 5000);
+    CHECK_MAP(u32map, uint32_t, U32_KEY, 5000);
+
+    // Key 0 (U64_KEY(0)) is covered above; the all-ones keys are ordinary keys too
+    u64map *m64 = c_u64map(16);
+    assert(m64);
+    int value;
+    assert(u64map_put(m64, UINT64_MAX, 1) == HM_SUCCESS && u64map_put(m64, 0, 2) == HM_SUCCESS);
+    assert(u64map_get(m64, UINT64_MAX, &value) == HM_SUCCESS && value == 1);
+    assert(u64map_get(m64, 0, &value) == HM_SUCCESS && value == 2);
+    assert(u64map_get(m64, UINT64_MAX - 1, &value) == HM_ERR_KEY_NOT_FOUND);
+    assert(u64map_delete(m64, UINT64_MAX) == HM_SUCCESS && !u64map_contains(m64, UINT64_MAX));
+    assert(u64map_contains(m64, 0) && m64->count == 1);
+    d_u64map(m64);
+
+    u32map *m32 = c_u32map(16);
+    assert(m32);
+    assert(u32map_put(m32, UINT32_MAX, 1) == HM_SUCCESS && u32map_put(m32, 0, 2) == HM_SUCCESS);
+    assert(u32map_get(m32, UINT32_MAX, &value) == HM_SUCCESS && value == 1);
+    assert(u32map_get(m32, 0, &value) == HM_SUCCESS && value == 2);
+    assert(u32map_delete(m32, 0) == HM_SUCCESS && !u32map_contains(m32, 0));
+    assert(u32map_contains(m32, UINT32_MAX) && m32->count == 1);
+    d_u32map(m32);
+
+    // Invalid arguments
+    assert(!c_u64map(0) && u64map_reserve(NULL, 1) == HM_ERR_INVALID_ARG);
+    assert(u32map_put(NULL, 1, 1) == HM_ERR_INVALID_ARG && !u32map_find(NULL, 1));
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,192 @@
+// Checks the string pool and symmap: interning equal bytes gives the same symbol and different
+// bytes different ones, also for prefixes, embedded NUL bytes, the empty string and a hash that
+// collides for everything; symbols and their bytes survive the pool's set growing and its
+// slabs filling up; and symmap put/get/find/delete/reserve work on symbols.
+// Build: gcc -O1 -I. tests/intern.c hashmap_intern.c hashmap_hash.c -o intern_test
+
+#include "hashmap_intern.h"
+
+#undef NDEBUG // The asserts are the test, and some of them make the calls being checked
+#include <assert.h>
+
+#define TEST_STRINGS 100000
+
+// Every string hashes the same, so only the bytes tell symbols apart
+static uint64_t one_hash(const void *data, size_t len, uint64_t seed)
+{
+    (void)data;
+    (void)len;
+    (void)seed;
+    return 42;
+}
+
+static int string_of(int i, char *str, size_t size)
+{
+    return snprintf(str, size, "string:%d", i);
+}
+
+/**
+ * @brief Equal bytes give one symbol, however they are passed in; different bytes do not.
+ */
+static void same_and_different(hm_hash_fn hash_fn, const char *name)
+{
+    hm_intern_pool* pool = c_intern_pool(hash_fn, 7);
+    assert(pool);
+    hm_symbol alpha = hm_intern(pool, "alpha");
+    assert(alpha && strcmp(hm_symbol_str(alpha), "alpha") == 0 && hm_symbol_len(alpha) == 5);
+
+    // The same bytes from another buffer, by length, and looked up
+    char copy[16];
+    strcpy(copy, "alpha");
+    assert(hm_intern(pool, copy) == alpha);
+    assert(hm_intern_n(pool, "alphabet", 5) == alpha);
+    assert(hm_intern_lookup(pool, "alpha") == alpha && hm_intern_lookup_n(pool, copy, 5) == alpha);
+    assert(hm_symbol_eq(hm_intern(pool, copy), alpha));
+    assert(hm_intern_count(pool) == 1);
+
+    // A prefix, an extension, one changed byte, and bytes with a NUL inside are all different
+    hm_symbol others[] = {
+        hm_intern(pool, "alph"),
+        hm_intern(pool, "alphab"),
+        hm_intern(pool, "alphb"),
+        hm_intern_n(pool, "alpha\0x", 7),
+        hm_intern_n(pool, "alpha\0y", 7),
+        hm_intern(pool, ""),
+    };
+    const int n = (int)(sizeof(others) / sizeof(others[0]));
+    for (int i = 0; i < n; i++) {
+        assert(others[i] && others[i] != alpha);
+        for (int j = 0; j < i; j++) {
+            assert(others[i] != others[j] && !hm_symbol_eq(others[i], others[j]));
+        }
+    }
+    assert(hm_symbol_len(others[3]) == 7 && memcmp(hm_symbol_str(others[3]), "alpha\0x", 8) == 0);
+    assert(hm_intern_n(pool, "alpha\0x", 7) == others[3]);
+    assert(hm_intern_n(pool, NULL, 0) == others[5] && hm_symbol_len(others[5]) == 0);
+    assert(hm_intern_count(pool) == 1 + n);
+
+    // Looking up what was never interned does not intern it
+    assert(!hm_intern_lookup(pool, "beta") && hm_intern_count(pool) == 1 + n);
+    d_intern_pool(pool);
+    printf("%s: equal strings share a symbol, different strings do not\n", name);
+}
+
+/**
+ * @brief Interns enough strings to grow the pool's set many times and fill many slabs, with a
+ * few strings too long for a slab in between, and checks every earlier symbol still stands.
+ */
+static void survives_growth(void)
+{
+    hm_intern_pool* pool = c_intern_pool(NULL, 0);
+    assert(pool);
+    hm_symbol *syms = malloc(TEST_STRINGS * sizeof(hm_symbol));
+    assert(syms);
+    size_t longLen = HM_SLAB_SIZE * 2;
+    char *longStr = malloc(longLen + 1);
+    assert(longStr);
+    char str[32];
+    for (int i = 0; i < TEST_STRINGS; i++) {
+        if (i % 25000 == 0) {
+            memset(longStr, 'a' + i / 25000, longLen);
+            longStr[longLen] = '\0';
+            hm_symbol big = hm_intern(pool, longStr);
+            assert(big && hm_symbol_len(big) == longLen && hm_intern(pool, longStr) == big);
+        }
+        int len = string_of(i, str, sizeof(str));
+        syms[i] = hm_intern(pool, str);
+        assert(syms[i] && hm_symbol_len(syms[i]) == (size_t)len);
+    }
+    assert(hm_intern_count(pool) == TEST_STRINGS + TEST_STRINGS / 25000);
+
+    for (int i = 0; i < TEST_STRINGS; i++) {
+        int len = string_of(i, str, sizeof(str));
+        assert(strcmp(hm_symbol_str(syms[i]), str) == 0 && hm_symbol_len(syms[i]) == (size_t)len);
+        assert(hm_symbol_hash(syms[i]) == hm_mix64(HM_DEFAULT_HASH(str, (size_t)len, 0)));
+        assert(hm_intern(pool, str) == syms[i] && hm_intern_lookup(pool, str) == syms[i]);
+    }
+    for (int c = 0; c < TEST_STRINGS / 25000; c++) {
+        memset(longStr, 'a' + c, longLen);
+        hm_symbol big = hm_intern_lookup(pool, longStr);
+        assert(big && memcmp(hm_symbol_str(big), longStr, longLen + 1) == 0);
+    }
+    assert(hm_intern_count(pool) == TEST_STRINGS + TEST_STRINGS / 25000);
+    free(longStr);
+    free(syms);
+    d_intern_pool(pool);
+    printf("pool: %d symbols unchanged while it grew\n", TEST_STRINGS);
+}
+
+/**
+ * @brief symmap keyed by symbols: put, update, get, find, contains, delete and reserve.
+ */
+static void symmap_ops(void)
+{
+    const int n = 20000;
+    hm_intern_pool* pool = c_intern_pool(NULL, 0);
+    assert(pool);
+    symmap *map = c_symmap(16);
+    assert(map);
+    char str[32];
+    for (int i = 0; i < n; i++) {
+        string_of(i, str, sizeof(str));
+        assert(symmap_put(map, hm_intern(pool, str), i) == HM_SUCCESS);
+    }
+    assert(map->count == n);
+
+    // Keys found again from their bytes, through the pool
+    for (int i = 0; i < n; i++) {
+        string_of(i, str, sizeof(str));
+        hm_symbol sym = hm_intern_lookup(pool, str);
+        int value;
+        assert(symmap_get(map, sym, &value) == HM_SUCCESS && value == i);
+        assert(symmap_contains(map, sym) && *symmap_find(map, sym) == i);
+        assert(symmap_put(map, sym, -i) == HM_SUCCESS);
+    }
+    assert(map->count == n);
+    for (int i = 1; i < n; i += 2) {
+        string_of(i, str, sizeof(str));
+        hm_symbol sym = hm_intern_lookup(pool, str);
+        assert(symmap_delete(map, sym) == HM_SUCCESS);
+        assert(symmap_delete(map, sym) == HM_ERR_KEY_NOT_FOUND && !symmap_contains(map, sym));
+    }
+    assert(map->count == n - n / 2);
+    for (int i = 0; i < n; i += 2) {
+        string_of(i, str, sizeof(str));
+        int value;
+        assert(symmap_get(map, hm_intern_lookup(pool, str), &value) == HM_SUCCESS && value == -i);
+    }
+
+    // A symbol interned but never put is not a key
+    int value;
+    assert(symmap_get(map, hm_intern(pool, "unused"), &value) == HM_ERR_KEY_NOT_FOUND);
+
+    // reserve makes room for the odd keys again without a rehash
+    assert(symmap_reserve(map, (size_t)n) == HM_SUCCESS);
+    int8_t *ctrl = map->ctrl;
+    for (int i = 1; i < n; i += 2) {
+        string_of(i, str, sizeof(str));
+        assert(symmap_put(map, hm_intern(pool, str), i) == HM_SUCCESS);
+    }
+    assert(map->ctrl == ctrl && map->count == n);
+    d_symmap(map);
+    d_intern_pool(pool);
+    printf("symmap: put, get, delete and reserve on %d symbols\n", n);
+}
+
+int main(void)
+{
+    same_and_different(NULL, "default hash");
+    same_and_different(one_hash, "colliding hash");
+    survives_growth();
+    symmap_ops();
+
+    // Invalid arguments
+    assert(!hm_intern(NULL, "a") && !hm_intern_n(NULL, "a", 1) && !hm_intern_lookup(NULL, "a"));
+    hm_intern_pool* pool = c_intern_pool(NULL, 0);
+    assert(pool && !hm_intern(pool, NULL) && !hm_intern_n(pool, NULL, 1));
+    assert(hm_intern_count(pool) == 0 && hm_intern_count(NULL) == 0);
+    d_intern_pool(pool);
+    d_intern_pool(NULL);
+    printf("ok\n");
+    return 0;
+}
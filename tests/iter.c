@@ -0,0 +1,246 @@
+// Checks hm_iter_erase: erasing the current entry mid-walk, every entry, the first and the
+// last entry of chains, entries of both bucket arrays during an incremental rehash, and swiss
+// slots that become tombstones. Each walk must visit every entry once, erased or not, and the
+// entries left must be exactly the ones not erased, with count to match.
+// Build: gcc -O1 -pthread -I. tests/iter.c hashmap.c hashmap_hash.c -o iter_test
+
+#include "hashmap.h"
+
+#undef NDEBUG // The asserts are the test, and some of them make the calls being checked
+#include <assert.h>
+
+#define TEST_KEYS 20000
+
+// Which entries a walk erases, from the key's index and the iterator on it
+typedef bool (*erase_rule)(int i, const hm_iter *it);
+
+static void key_of(int i, char *key, size_t size)
+{
+    snprintf(key, size, "key:%d", i);
+}
+
+static int index_of(const hm_iter *it)
+{
+    assert(it->key_len > 4 && memcmp(it->key, "key:", 4) == 0);
+    return atoi(it->key + 4);
+}
+
+// A hash with 8 values, so the chained engine builds long chains
+static uint64_t few_hashes(const void *data, size_t len, uint64_t seed)
+{
+    return hm_hash_wy(data, len, seed) & 7;
+}
+
+static bool erase_odd(int i, const hm_iter *it)
+{
+    (void)it;
+    return i % 2;
+}
+
+static bool erase_all(int i, const hm_iter *it)
+{
+    (void)i;
+    (void)it;
+    return true;
+}
+
+static bool erase_chain_last(int i, const hm_iter *it)
+{
+    (void)i;
+    return !it->current->next;
+}
+
+// Bucket whose first entry erase_chain_first erased last; once it is, the next entry is first
+static size_t erasedBucket;
+
+static bool erase_chain_first(int i, const hm_iter *it)
+{
+    (void)i;
+    size_t bucket = it->pos - 1;
+    pair **head = bucket < (size_t)it->map->size ? &it->map->buckets[bucket] : &it->map->old_buckets[bucket - it->map->size];
+    if (it->link != head || bucket == erasedBucket) {
+        return false;
+    }
+    erasedBucket = bucket;
+    return true;
+}
+
+/**
+ * @brief Walks a map holding keys 0..n-1 (those with present[i] set), erasing the entries rule
+ * picks, and checks that each entry was visited once and that the map now holds the rest.
+ * @return The number of entries erased.
+ */
+static int walk_erasing(hashmap* map, bool *present, int n, erase_rule rule)
+{
+    int before = map->count;
+    unsigned char *visits = calloc((size_t)n, 1);
+    assert(visits);
+    int erased = 0;
+    hm_iter it;
+    assert(hm_iter_begin(map, &it) == HM_SUCCESS);
+    while (hm_iter_next(&it)) {
+        int i = index_of(&it);
+        assert(i < n && present[i] && it.value == i && visits[i]++ == 0);
+        if (rule(i, &it)) {
+            assert(hm_iter_erase(&it) == HM_SUCCESS);
+            assert(!it.key);
+            present[i] = false;
+            erased++;
+        }
+    }
+    // Entries are visited at most once and were all present, so before visits cover them all
+    int visited = 0;
+    int left = 0;
+    for (int i = 0; i < n; i++) {
+        visited += visits[i];
+        left += present[i];
+    }
+    assert(visited == before && map->count == before - erased && map->count == left);
+
+    // A second walk sees each entry left exactly once
+    memset(visits, 0, (size_t)n);
+    int walked = 0;
+    assert(hm_iter_begin(map, &it) == HM_SUCCESS);
+    while (hm_iter_next(&it)) {
+        int i = index_of(&it);
+        assert(present[i] && visits[i]++ == 0);
+        walked++;
+    }
+    assert(walked == left);
+    free(visits);
+
+    char key[32];
+    for (int i = 0; i < n; i++) {
+        key_of(i, key, sizeof(key));
+        assert(contains_key(map, key) == present[i]);
+    }
+    return erased;
+}
+
+/**
+ * @brief Fills a map with keys 0..n-1, each key's value its index.
+ */
+static void fill(hashmap* map, bool *present, int n)
+{
+    char key[32];
+    for (int i = 0; i < n; i++) {
+        key_of(i, key, sizeof(key));
+        assert(put(map, key, i) == HM_SUCCESS);
+        present[i] = true;
+    }
+}
+
+/**
+ * @brief Erases the odd keys and then the rest, and checks the map is still usable after.
+ */
+static void erase_odd_then_all(const char *name, const hashmap_options *opts)
+{
+    hashmap* map = c_hashmap_ex(16, opts);
+    assert(map);
+    bool *present = malloc(TEST_KEYS * sizeof(bool));
+    assert(present);
+    fill(map, present, TEST_KEYS);
+    assert(walk_erasing(map, present, TEST_KEYS, erase_odd) == TEST_KEYS / 2);
+    assert(walk_erasing(map, present, TEST_KEYS, erase_all) == TEST_KEYS - TEST_KEYS / 2);
+    assert(map->count == 0);
+
+    // Freed buckets, slots and tombstones are reused by later puts
+    fill(map, present, TEST_KEYS);
+    assert(walk_erasing(map, present, TEST_KEYS, erase_odd) == TEST_KEYS / 2);
+    free(present);
+    d_hashmap(map);
+    printf("%s: odd entries, then all, erased mid-walk\n", name);
+}
+
+/**
+ * @brief Erases the last and then the first entry of every chain of a map with long chains.
+ */
+static void erase_chain_ends(const char *name, const hashmap_options *opts)
+{
+    const int n = 2000;
+    hashmap* map = c_hashmap_ex(16, opts);
+    assert(map);
+    bool *present = malloc((size_t)n * sizeof(bool));
+    assert(present);
+    fill(map, present, n);
+    int erased = walk_erasing(map, present, n, erase_chain_last);
+    assert(erased >= 1 && erased <= 8);
+    erasedBucket = SIZE_MAX;
+    erased = walk_erasing(map, present, n, erase_chain_first);
+    assert(erased >= 1 && erased <= 8);
+    assert(walk_erasing(map, present, n, erase_odd) > 0);
+    free(present);
+    d_hashmap(map);
+    printf("%s: chain ends erased\n", name);
+}
+
+/**
+ * @brief Erases entries while an incremental rehash is part way, from both bucket arrays.
+ */
+static void erase_while_rehashing(void)
+{
+    hashmap* map = c_hashmap_ex(16, &(hashmap_options){ .incremental = true });
+    assert(map);
+    // Room for the keys put until a rehash starts and then until it ends, at most twice as many
+    bool *present = malloc(2 * TEST_KEYS * sizeof(bool));
+    assert(present);
+    char key[32];
+    int n = 0;
+    while (n < TEST_KEYS / 2 || !map->old_buckets) {
+        assert(n < TEST_KEYS);
+        key_of(n, key, sizeof(key));
+        assert(put(map, key, n) == HM_SUCCESS);
+        present[n++] = true;
+    }
+    int oldSize = map->old_size;
+
+    // Entries still in the old array are walked after the new one; erase from both
+    int erasedOld = 0;
+    hm_iter it;
+    assert(hm_iter_begin(map, &it) == HM_SUCCESS);
+    while (hm_iter_next(&it)) {
+        if (it.pos > (size_t)map->size && index_of(&it) % 3 == 0) {
+            present[index_of(&it)] = false;
+            assert(hm_iter_erase(&it) == HM_SUCCESS);
+            erasedOld++;
+        }
+    }
+    assert(erasedOld > 0);
+    assert(map->old_buckets && map->old_size == oldSize); // Erasing does not step the rehash
+    int erased = walk_erasing(map, present, n, erase_odd);
+    assert(erased > 0 && map->old_buckets);
+
+    // Finish the rehash with more puts; the entries left survive it
+    while (map->old_buckets) {
+        assert(n < 2 * TEST_KEYS);
+        key_of(n, key, sizeof(key));
+        assert(put(map, key, n) == HM_SUCCESS);
+        present[n++] = true;
+    }
+    assert(walk_erasing(map, present, n, erase_odd) > 0);
+    free(present);
+    d_hashmap(map);
+    printf("incremental: %d entries erased from the old buckets mid-rehash\n", erasedOld);
+}
+
+int main(void)
+{
+    erase_odd_then_all("chained", &(hashmap_options){ 0 });
+    erase_odd_then_all("chained, pow2, arena", &(hashmap_options){ .pow2 = true, .arena = true });
+    erase_odd_then_all("swiss", &(hashmap_options){ .engine = HM_ENGINE_SWISS });
+    erase_odd_then_all("swiss, arena", &(hashmap_options){ .engine = HM_ENGINE_SWISS, .arena = true });
+    erase_chain_ends("chained, 8 chains", &(hashmap_options){ .hash_fn = few_hashes });
+    erase_chain_ends("chained, 8 chains, arena", &(hashmap_options){ .hash_fn = few_hashes, .arena = true });
+    erase_while_rehashing();
+
+    // Erasing twice, or before the first entry, is refused
+    hashmap* map = c_hashmap(16);
+    assert(map && put(map, "a", 1) == HM_SUCCESS);
+    hm_iter it;
+    assert(hm_iter_begin(map, &it) == HM_SUCCESS && hm_iter_erase(&it) == HM_ERR_INVALID_ARG);
+    assert(hm_iter_next(&it) && hm_iter_erase(&it) == HM_SUCCESS);
+    assert(hm_iter_erase(&it) == HM_ERR_INVALID_ARG && map->count == 0 && !hm_iter_next(&it));
+    d_hashmap(map);
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,175 @@
+// Checks that resizes split across rehash threads (opts.resize_threads) keep every pair: maps
+// grown with 1, 2, 4 and 8 threads, with and without the arena and pow2 layouts, by doubling
+// and by reserve to a size that is not a doubling; and that a resize whose bucket array cannot
+// be allocated, or whose worker threads cannot be started, leaves a complete, usable map.
+// Build: gcc -O1 -pthread -I. -Wl,--wrap=malloc,--wrap=calloc,--wrap=pthread_create tests/parallel_resize.c hashmap.c hashmap_hash.c -o parallel_resize_test
+
+#include "hashmap.h"
+
+#undef NDEBUG // The asserts are the test, and some of them make the calls being checked
+#include <assert.h>
+#include <errno.h>
+
+// Enough keys that the last doublings have HM_PARALLEL_REHASH_MIN old buckets per thread for 8 threads
+#define TEST_KEYS 300000
+
+// While set, allocations of at least FAIL_FROM_BYTES fail: the bucket array of a large map
+// does, pairs, keys and arena slabs do not
+#define FAIL_FROM_BYTES (256 * 1024)
+static bool failLargeAllocs;
+// Number of upcoming pthread_create calls that fail, as when the process is out of memory for stacks
+static int failThreadCreates;
+// Worker threads actually started
+static int threadsStarted;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+int __real_pthread_create(pthread_t *thread, const pthread_attr_t *attr, void *(*start)(void *), void *arg);
+
+void *__wrap_malloc(size_t size)
+{
+    return failLargeAllocs && size >= FAIL_FROM_BYTES ? NULL : __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    return failLargeAllocs && n * size >= FAIL_FROM_BYTES ? NULL : __real_calloc(n, size);
+}
+
+int __wrap_pthread_create(pthread_t *thread, const pthread_attr_t *attr, void *(*start)(void *), void *arg)
+{
+    if (failThreadCreates > 0) {
+        failThreadCreates--;
+        return EAGAIN;
+    }
+    threadsStarted++;
+    return __real_pthread_create(thread, attr, start, arg);
+}
+
+static void key_of(int i, char *key, size_t size)
+{
+    snprintf(key, size, "key:%d", i);
+}
+
+/**
+ * @brief Asserts that map holds exactly keys 0..n-1, key i with value i + delta, each once.
+ */
+static void check_map(hashmap* map, int n, int delta)
+{
+    assert(map->count == n && !map->old_buckets);
+    char key[32];
+    for (int i = 0; i < n; i++) {
+        key_of(i, key, sizeof(key));
+        int value;
+        assert(get(map, key, &value) == HM_SUCCESS && value == i + delta);
+    }
+    // A pair linked into two chains, or lost from all, shows up in the walk
+    int walked = 0;
+    hm_iter it;
+    assert(hm_iter_begin(map, &it) == HM_SUCCESS);
+    while (hm_iter_next(&it)) {
+        walked++;
+    }
+    assert(walked == n);
+}
+
+/**
+ * @brief Grows a map from 16 buckets to TEST_KEYS pairs, resizes it explicitly, and checks it.
+ */
+static void grow(const char *name, int threads, bool arena, bool pow2)
+{
+    hashmap_options opts = { .resize_threads = threads, .arena = arena, .pow2 = pow2 };
+    hashmap* map = c_hashmap_ex(16, &opts);
+    assert(map);
+    char key[32];
+    threadsStarted = 0;
+    for (int i = 0; i < TEST_KEYS; i++) {
+        key_of(i, key, sizeof(key));
+        assert(put(map, key, i) == HM_SUCCESS);
+    }
+    check_map(map, TEST_KEYS, 0);
+    assert(threads > 1 ? threadsStarted > 0 : threadsStarted == 0);
+
+    // An explicit doubling, then a reserve to a size that is not a doubling, so ranges of old
+    // buckets feed overlapping new buckets (pow2 maps round it up to a doubling again)
+    assert(resize(map) == HM_SUCCESS);
+    check_map(map, TEST_KEYS, 0);
+    int size = map->size;
+    assert(reserve(map, (size_t)(size * 3 * MAX_FACTOR)) == HM_SUCCESS && map->size > size);
+    check_map(map, TEST_KEYS, 0);
+    printf("%s, %d threads: %d pairs in %d buckets, %d worker threads started\n",
+           name, threads, map->count, map->size, threadsStarted);
+    d_hashmap(map);
+}
+
+/**
+ * @brief Makes a parallel resize fail to allocate, then to start its workers, and checks the
+ * map each time. The workers allocate nothing themselves: the new bucket array, allocated
+ * before any of them starts, is the only allocation a resize makes.
+ */
+static void failures(bool arena)
+{
+    hashmap_options opts = { .resize_threads = 8, .arena = arena };
+    hashmap* map = c_hashmap_ex(16, &opts);
+    assert(map);
+    char key[32];
+    for (int i = 0; i < TEST_KEYS; i++) {
+        key_of(i, key, sizeof(key));
+        assert(put(map, key, i) == HM_SUCCESS);
+    }
+
+    // No memory for the new buckets: the resize fails and the map is left as it was
+    int size = map->size;
+    failLargeAllocs = true;
+    assert(resize(map) == HM_ERR_MALLOC_FAILED);
+    assert(reserve(map, (size_t)size * 4) == HM_ERR_MALLOC_FAILED);
+    failLargeAllocs = false;
+    assert(map->size == size);
+    check_map(map, TEST_KEYS, 0);
+
+    // Still usable: updates, deletes and new keys, with the growth they trigger
+    for (int i = 0; i < TEST_KEYS; i++) {
+        key_of(i, key, sizeof(key));
+        assert(put(map, key, i + 1) == HM_SUCCESS);
+    }
+    check_map(map, TEST_KEYS, 1);
+
+    // Only some workers start: the calling thread migrates the other ranges itself
+    failThreadCreates = 3;
+    threadsStarted = 0;
+    assert(resize(map) == HM_SUCCESS && map->size == size * 2);
+    assert(failThreadCreates == 0 && threadsStarted > 0);
+    check_map(map, TEST_KEYS, 1);
+
+    // None start
+    failThreadCreates = HM_PARALLEL_REHASH_MAX_THREADS;
+    threadsStarted = 0;
+    assert(resize(map) == HM_SUCCESS && map->size == size * 4);
+    assert(threadsStarted == 0);
+    failThreadCreates = 0;
+    check_map(map, TEST_KEYS, 1);
+
+    for (int i = 0; i < TEST_KEYS; i += 2) {
+        key_of(i, key, sizeof(key));
+        assert(delete_key(map, key) == HM_SUCCESS);
+    }
+    assert(map->count == TEST_KEYS / 2);
+    d_hashmap(map);
+    printf("failures%s: map intact after a failed allocation and after failed thread starts\n",
+           arena ? ", arena" : "");
+}
+
+int main(void)
+{
+    const int threads[] = { 1, 2, 4, 8 };
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+        grow("chained", threads[t], false, false);
+        grow("arena", threads[t], true, false);
+    }
+    grow("pow2", 8, false, true);
+    grow("arena, pow2", 8, true, true);
+    failures(false);
+    failures(true);
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,238 @@
+// Checks reserve, shrink_to_fit and opts.shrink_factor for every engine: a map reserved for n
+// entries takes n puts without a resize, also a swiss map full of tombstones; shrink_to_fit and
+// automatic shrinking keep every entry while lowering the size; and a reserve or shrink whose
+// allocation fails leaves the map as it was and usable.
+// Build: gcc -O1 -pthread -I. -Wl,--wrap=malloc,--wrap=calloc tests/reserve.c hashmap.c hashmap_hash.c -o reserve_test
+
+#include "hashmap.h"
+
+#undef NDEBUG // The asserts are the test, and some of them make the calls being checked
+#include <assert.h>
+
+#define TEST_KEYS 20000
+
+// While set, every allocation fails
+static bool failAllocs;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    return failAllocs ? NULL : __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    return failAllocs ? NULL : __real_calloc(n, size);
+}
+
+static void key_of(int i, char *key, size_t size)
+{
+    snprintf(key, size, "key:%d", i);
+}
+
+/**
+ * @brief The array a resize replaces: bucket pointers (chained) or control bytes (swiss).
+ */
+static const void *table_of(const hashmap* map)
+{
+    return map->engine == HM_ENGINE_SWISS ? (const void *)map->ctrl : (const void *)map->buckets;
+}
+
+static void put_range(hashmap* map, int from, int to)
+{
+    char key[32];
+    for (int i = from; i < to; i++) {
+        key_of(i, key, sizeof(key));
+        assert(put(map, key, i) == HM_SUCCESS);
+    }
+}
+
+static void delete_range(hashmap* map, int from, int to)
+{
+    char key[32];
+    for (int i = from; i < to; i++) {
+        key_of(i, key, sizeof(key));
+        assert(delete_key(map, key) == HM_SUCCESS);
+    }
+}
+
+/**
+ * @brief Asserts that map holds exactly the keys in [from, to), each with its index as value.
+ */
+static void check_range(hashmap* map, int from, int to)
+{
+    assert(map->count == to - from);
+    char key[32];
+    for (int i = from; i < to; i++) {
+        key_of(i, key, sizeof(key));
+        int value;
+        assert(get(map, key, &value) == HM_SUCCESS && value == i);
+    }
+    int walked = 0;
+    hm_iter it;
+    assert(hm_iter_begin(map, &it) == HM_SUCCESS);
+    while (hm_iter_next(&it)) {
+        walked++;
+    }
+    assert(walked == to - from);
+}
+
+/**
+ * @brief reserve(n) on a fresh map, then n puts: neither the size nor the table may change.
+ */
+static void reserve_holds(const char *name, const hashmap_options *opts)
+{
+    hashmap* map = c_hashmap_ex(16, opts);
+    assert(map);
+    assert(reserve(map, TEST_KEYS) == HM_SUCCESS);
+    int size = map->size;
+    const void *table = table_of(map);
+    put_range(map, 0, TEST_KEYS);
+    assert(map->size == size && table_of(map) == table && !map->old_buckets);
+    check_range(map, 0, TEST_KEYS);
+
+    // Reserving no more than the map already holds changes nothing
+    assert(reserve(map, TEST_KEYS / 2) == HM_SUCCESS && reserve(map, 0) == HM_SUCCESS);
+    assert(map->size == size && table_of(map) == table);
+
+    // Fill to the limit and delete most keys: a swiss map is left with tombstones that use up
+    // its growth budget, and reserve must make room for n new puts all the same
+    if (map->engine == HM_ENGINE_SWISS) {
+        int limit = hm_growth_cap(map->size);
+        put_range(map, TEST_KEYS, limit);
+        assert(map->growth_left == 0);
+        delete_range(map, 0, limit - TEST_KEYS / 8);
+        assert(map->growth_left + map->count < TEST_KEYS);
+        assert(reserve(map, TEST_KEYS) == HM_SUCCESS && map->size == size);
+        table = table_of(map);
+        put_range(map, limit, limit + TEST_KEYS - TEST_KEYS / 8);
+        assert(table_of(map) == table);
+        check_range(map, limit - TEST_KEYS / 8, limit + TEST_KEYS - TEST_KEYS / 8);
+    }
+    d_hashmap(map);
+    printf("%s: reserve(%d) holds %d puts in %d buckets\n", name, TEST_KEYS, TEST_KEYS, size);
+}
+
+/**
+ * @brief shrink_to_fit after most keys are deleted, also below the size the map was created
+ * with, and on a map it cannot shrink.
+ */
+static void shrink_fits(const char *name, const hashmap_options *opts)
+{
+    hashmap* map = c_hashmap_ex(1024, opts);
+    assert(map);
+    put_range(map, 0, TEST_KEYS);
+    delete_range(map, 0, TEST_KEYS - 100);
+    int size = map->size;
+    assert(shrink_to_fit(map) == HM_SUCCESS);
+    assert(map->size < size && map->size < 1024 && !map->old_buckets);
+    check_range(map, TEST_KEYS - 100, TEST_KEYS);
+
+    // Already as small as it can be
+    size = map->size;
+    const void *table = table_of(map);
+    assert(shrink_to_fit(map) == HM_SUCCESS && map->size == size && table_of(map) == table);
+
+    // And it still grows
+    put_range(map, 0, TEST_KEYS - 100);
+    check_range(map, 0, TEST_KEYS);
+    d_hashmap(map);
+    printf("%s: shrink_to_fit from %d pairs down to 100\n", name, TEST_KEYS);
+}
+
+/**
+ * @brief opts.shrink_factor: deleting most keys shrinks the map, never below its initial size.
+ */
+static void shrinks_on_delete(const char *name, hashmap_options opts)
+{
+    opts.shrink_factor = 0.2f;
+    hashmap* map = c_hashmap_ex(64, &opts);
+    assert(map);
+    put_range(map, 0, TEST_KEYS);
+    int grown = map->size;
+    int shrinks = 0;
+    char key[32];
+    for (int i = 0; i < TEST_KEYS; i++) {
+        int size = map->size;
+        key_of(i, key, sizeof(key));
+        assert(delete_key(map, key) == HM_SUCCESS);
+        assert(map->size >= 64);
+        shrinks += map->size < size;
+    }
+    assert(shrinks > 0 && map->size < grown && map->count == 0);
+    put_range(map, 0, 100);
+    check_range(map, 0, 100);
+    d_hashmap(map);
+    printf("%s: shrank %d times while deleting %d pairs\n", name, shrinks, TEST_KEYS);
+}
+
+/**
+ * @brief Fails the allocation of reserve, of shrink_to_fit and of an automatic shrink, and
+ * checks the map after each.
+ */
+static void allocation_failures(const char *name, hashmap_options opts)
+{
+    opts.shrink_factor = 0.2f;
+    hashmap* map = c_hashmap_ex(16, &opts);
+    assert(map);
+    put_range(map, 0, TEST_KEYS);
+    int size = map->size;
+    const void *table = table_of(map);
+
+    failAllocs = true;
+    assert(reserve(map, TEST_KEYS * 4) == HM_ERR_MALLOC_FAILED);
+    failAllocs = false;
+    assert(map->size == size && table_of(map) == table);
+    check_range(map, 0, TEST_KEYS);
+
+    // Delete down to the shrink threshold; past it, deletes succeed while the shrinks they
+    // start cannot allocate, and the map keeps its size
+    int threshold = (int)(map->shrink_factor * (float)size) + 1;
+    delete_range(map, 0, TEST_KEYS - threshold);
+    assert(map->size == size);
+    int first = TEST_KEYS - threshold + 10;
+    failAllocs = true;
+    delete_range(map, TEST_KEYS - threshold, first);
+    failAllocs = false;
+    assert(map->size == size && table_of(map) == table);
+    check_range(map, first, TEST_KEYS);
+
+    failAllocs = true;
+    assert(shrink_to_fit(map) == HM_ERR_MALLOC_FAILED);
+    failAllocs = false;
+    assert(map->size == size && table_of(map) == table);
+    check_range(map, first, TEST_KEYS);
+
+    // Once memory is back, all of it works
+    assert(shrink_to_fit(map) == HM_SUCCESS && map->size < size);
+    check_range(map, first, TEST_KEYS);
+    assert(reserve(map, TEST_KEYS) == HM_SUCCESS);
+    put_range(map, 0, first);
+    check_range(map, 0, TEST_KEYS);
+    d_hashmap(map);
+    printf("%s: failed reserve and shrinks leave the map intact\n", name);
+}
+
+int main(void)
+{
+    const struct
+    {
+        const char *name;
+        hashmap_options opts;
+    } engines[] = {
+        { "chained", { 0 } },
+        { "chained, pow2, arena", { .pow2 = true, .arena = true } },
+        { "chained, incremental", { .incremental = true } },
+        { "swiss", { .engine = HM_ENGINE_SWISS } },
+    };
+    for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++) {
+        reserve_holds(engines[e].name, &engines[e].opts);
+        shrink_fits(engines[e].name, &engines[e].opts);
+        shrinks_on_delete(engines[e].name, engines[e].opts);
+        allocation_failures(engines[e].name, engines[e].opts);
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,120 @@
+// Checks shashmap for every shard engine: concurrent puts, updates, deletes and lookups while
+// the shards resize, and that the hash handed to a shard through the *_hashed entry points
+// finds the same pairs as the shard's own put_n/get_n.
+// Build: gcc -O1 -pthread -I. tests/sharded.c hashmap_sharded.c hashmap.c hashmap_hash.c -o sharded_test
+
+#include "hashmap_sharded.h"
+
+#undef NDEBUG // The asserts are the test, and some of them make the calls being checked
+#include <assert.h>
+
+#define TEST_THREADS 4
+#define TEST_KEYS_PER_THREAD 20000
+
+typedef struct test_thread
+{
+    shashmap *map;
+    int id;
+} test_thread;
+
+static void key_of(int thread, int i, char *key, size_t size)
+{
+    snprintf(key, size, "t%d:%d", thread, i);
+}
+
+// Each thread works on its own keys, which land in every shard; keys with index % 5 == 4 are
+// deleted again, and every key is looked up straight after each change
+static void *worker_main(void *arg)
+{
+    test_thread *t = arg;
+    char key[32];
+    int value;
+    for (int i = 0; i < TEST_KEYS_PER_THREAD; i++) {
+        key_of(t->id, i, key, sizeof(key));
+        assert(shd_put(t->map, key, 2 * i) == HM_SUCCESS);
+        assert(shd_get(t->map, key, &value) == HM_SUCCESS && value == 2 * i);
+        assert(shd_put(t->map, key, 2 * i + 1) == HM_SUCCESS);
+        assert(shd_get(t->map, key, &value) == HM_SUCCESS && value == 2 * i + 1);
+        if (i % 5 == 4) {
+            assert(shd_delete(t->map, key) == HM_SUCCESS);
+            assert(!shd_contains(t->map, key));
+            assert(shd_delete(t->map, key) == HM_ERR_KEY_NOT_FOUND);
+        }
+        // An earlier key must have survived the resizes since
+        int j = i / 2;
+        key_of(t->id, j, key, sizeof(key));
+        HashMapStatus status = shd_get(t->map, key, &value);
+        assert(j % 5 == 4 ? status == HM_ERR_KEY_NOT_FOUND : status == HM_SUCCESS && value == 2 * j + 1);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs the workers against a sharded map whose shards start small, then checks each
+ * shard's map directly, both through put_n/get_n and through the pre-hashed entry points.
+ */
+static void run(const char *name, const hashmap_options *opts)
+{
+    shashmap *map = c_shashmap(16, 8, opts);
+    assert(map);
+    pthread_t threads[TEST_THREADS];
+    test_thread args[TEST_THREADS];
+    for (int i = 0; i < TEST_THREADS; i++) {
+        args[i] = (test_thread){ map, i };
+        assert(pthread_create(&threads[i], NULL, worker_main, &args[i]) == 0);
+    }
+    for (int i = 0; i < TEST_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    assert(shd_count(map) == TEST_THREADS * (TEST_KEYS_PER_THREAD - TEST_KEYS_PER_THREAD / 5));
+
+    char key[32];
+    int value;
+    int found = 0;
+    for (int t = 0; t < TEST_THREADS; t++) {
+        for (int i = 0; i < TEST_KEYS_PER_THREAD; i++) {
+            key_of(t, i, key, sizeof(key));
+            size_t len = strlen(key);
+            uint64_t hash = map->hash_fn(key, len, map->seed);
+            bool inShard = false;
+            for (int s = 0; s < map->shard_count; s++) {
+                hashmap *shard = map->shards[s].map;
+                int hashedValue;
+                HashMapStatus status = get_n(shard, key, len, &value);
+                assert(status == hm_get_hashed(shard, key, len, hash, &hashedValue));
+                assert(contains_n(shard, key, len) == hm_contains_hashed(shard, key, len, hash));
+                if (status == HM_SUCCESS) {
+                    assert(!inShard && value == hashedValue && value == 2 * i + 1);
+                    inShard = true;
+                }
+            }
+            assert(inShard == (i % 5 != 4));
+            found += inShard;
+        }
+    }
+    assert(found == shd_count(map));
+
+    // Pairs written through one path are found and removed through the other
+    hashmap *shard = map->shards[0].map;
+    uint64_t hash = map->hash_fn("direct", 6, map->seed);
+    assert(hm_put_hashed(shard, "direct", 6, hash, 7) == HM_SUCCESS);
+    assert(get_n(shard, "direct", 6, &value) == HM_SUCCESS && value == 7);
+    assert(put_n(shard, "direct", 6, 8) == HM_SUCCESS);
+    assert(hm_get_hashed(shard, "direct", 6, hash, &value) == HM_SUCCESS && value == 8);
+    assert(hm_delete_hashed(shard, "direct", 6, hash) == HM_SUCCESS);
+    assert(!contains_n(shard, "direct", 6));
+
+    printf("%s: %d pairs in %d shards\n", name, shd_count(map), map->shard_count);
+    d_shashmap(map);
+}
+
+int main(void)
+{
+    run("chained", &(hashmap_options){ 0 });
+    run("chained, pow2", &(hashmap_options){ .pow2 = true });
+    run("chained, incremental", &(hashmap_options){ .incremental = true });
+    run("swiss", &(hashmap_options){ .engine = HM_ENGINE_SWISS });
+    run("swiss, wyhash", &(hashmap_options){ .engine = HM_ENGINE_SWISS, .hash_fn = hm_hash_wy, .seed = 42 });
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,136 @@
+// Checks that hm_save followed by hm_open_mmap gives back the saved map, for every engine,
+// for keys with embedded NUL bytes and long keys, for an empty map and for a snapshot saved
+// again from a snapshot map; that saving over an existing snapshot replaces it; and that a
+// save that runs out of disk space fails cleanly and leaves the old snapshot in place.
+// Build: gcc -O1 -pthread -I. -Wl,--wrap=posix_fallocate tests/snapshot.c hashmap.c hashmap_hash.c -o snapshot_test
+// Usage: ./snapshot_test [snapshot_path]
+
+#include "hashmap.h"
+
+#undef NDEBUG // The asserts are the test, and some of them make the calls being checked
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// When set, hm_save finds the disk full
+static bool diskFull;
+
+int __real_posix_fallocate(int fd, off_t offset, off_t len);
+
+int __wrap_posix_fallocate(int fd, off_t offset, off_t len)
+{
+    return diskFull ? ENOSPC : __real_posix_fallocate(fd, offset, len);
+}
+
+/**
+ * @brief Asserts that every pair of expected is in actual with the same value.
+ */
+static void assert_contains_all(hashmap* expected, const hashmap* actual)
+{
+    hm_iter it;
+    assert(hm_iter_begin(expected, &it) == HM_SUCCESS);
+    while (hm_iter_next(&it)) {
+        int value;
+        assert(get_n(actual, it.key, it.key_len, &value) == HM_SUCCESS && value == it.value);
+        assert(contains_n(actual, it.key, it.key_len));
+    }
+}
+
+static void assert_same(hashmap* expected, hashmap* actual)
+{
+    assert(expected->count == actual->count);
+    assert_contains_all(expected, actual);
+    assert_contains_all(actual, expected);
+}
+
+/**
+ * @brief Fills a map with n short keys, a few with NUL bytes inside and a few long ones.
+ */
+static void fill(hashmap* map, int n)
+{
+    char key[64];
+    for (int i = 0; i < n; i++) {
+        int len = snprintf(key, sizeof(key), "key:%d", i);
+        assert(put_n(map, key, (size_t)len, i) == HM_SUCCESS);
+    }
+    for (int i = 0; i < n / 100; i++) {
+        char binary[12] = { 'b', 0, (char)i, 0, (char)(i >> 8), 'x' };
+        assert(put_n(map, binary, sizeof(binary), -i) == HM_SUCCESS);
+    }
+    char longKey[3000];
+    memset(longKey, 'L', sizeof(longKey));
+    for (int i = 0; i < 3; i++) {
+        longKey[i] = '0' + (char)i;
+        assert(put_n(map, longKey, sizeof(longKey) - 7 * (size_t)i, 1000 + i) == HM_SUCCESS);
+    }
+}
+
+static void round_trip(const char *path, const char *name, const hashmap_options *opts, int n)
+{
+    hashmap* map = c_hashmap_ex(16, opts);
+    assert(map);
+    if (n > 0) {
+        fill(map, n);
+    }
+    assert(hm_save(map, path) == HM_SUCCESS);
+    hashmap* snap = hm_open_mmap(path);
+    assert(snap && snap->engine == HM_ENGINE_SNAPSHOT);
+    assert_same(map, snap);
+
+    // Misses, including keys that differ only in length
+    int value;
+    assert(get_n(snap, "key:", 4, &value) == HM_ERR_KEY_NOT_FOUND);
+    assert(!contains_n(snap, "key:1", 6));
+    assert(!contains_key(snap, "missing"));
+
+    // A snapshot map can be saved again, over the file it is mapped from
+    assert(hm_save(snap, path) == HM_SUCCESS);
+    hashmap* again = hm_open_mmap(path);
+    assert(again);
+    assert_same(map, again);
+    assert_same(map, snap); // The old mapping still reads the replaced file
+    d_hashmap(again);
+    d_hashmap(snap);
+    d_hashmap(map);
+    printf("%s: %d pairs round-trip\n", name, n);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "snapshot_test.bin";
+    round_trip(path, "empty", &(hashmap_options){ 0 }, 0);
+    round_trip(path, "chained", &(hashmap_options){ 0 }, 20000);
+    round_trip(path, "chained, pow2, arena", &(hashmap_options){ .pow2 = true, .arena = true }, 20000);
+    round_trip(path, "chained, incremental", &(hashmap_options){ .incremental = true }, 20000);
+    round_trip(path, "swiss, wyhash", &(hashmap_options){ .engine = HM_ENGINE_SWISS, .hash_fn = hm_hash_wy, .seed = 9 }, 20000);
+
+    // Out of space: the save fails, no temporary file is left and the old snapshot still opens
+    hashmap* map = c_hashmap(16);
+    assert(map);
+    fill(map, 1000);
+    assert(hm_save(map, path) == HM_SUCCESS);
+    assert(put(map, "newer", 1) == HM_SUCCESS);
+    diskFull = true;
+    assert(hm_save(map, path) == HM_ERR_IO);
+    diskFull = false;
+    char tmpPath[4096];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    assert(access(tmpPath, F_OK) != 0);
+    hashmap* old = hm_open_mmap(path);
+    assert(old && old->count == map->count - 1 && !contains_key(old, "newer"));
+    d_hashmap(old);
+    d_hashmap(map);
+    printf("full disk: save fails, old snapshot kept\n");
+
+    // Files that are not snapshots are refused
+    FILE *file = fopen(path, "wb");
+    assert(file);
+    fputs("not a snapshot", file);
+    fclose(file);
+    assert(!hm_open_mmap(path));
+    unlink(path);
+    assert(!hm_open_mmap(path));
+    printf("ok\n");
+    return 0;
+}
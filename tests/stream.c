@@ -0,0 +1,212 @@
+// Checks that hm_stream_write followed by hm_stream_read gives back the written map: through
+// memory and through a file, with a reader that returns a few bytes per call, with keys
+// larger than a batch, into a map that already holds some of the keys, and from a snapshot
+// map; and that every truncation of a stream, and a header claiming too many entries, is
+// reported instead of loaded.
+// Build: gcc -O1 -pthread -I. tests/stream.c hashmap.c hashmap_hash.c -o stream_test
+// Usage: ./stream_test [scratch_path]
+
+#include "hashmap.h"
+
+#undef NDEBUG // The asserts are the test, and some of them make the calls being checked
+#include <assert.h>
+#include <unistd.h>
+
+// A stream held in memory; reads hand out at most chunk bytes per call when chunk is set
+typedef struct mem_stream
+{
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+    size_t pos;
+    size_t chunk;
+} mem_stream;
+
+static bool mem_write(void *ctx, const void *data, size_t len)
+{
+    mem_stream *s = ctx;
+    if (s->len + len > s->cap) {
+        s->cap = (s->len + len) * 2;
+        s->data = realloc(s->data, s->cap);
+        assert(s->data);
+    }
+    memcpy(s->data + s->len, data, len);
+    s->len += len;
+    return true;
+}
+
+static size_t mem_read(void *ctx, void *buf, size_t len)
+{
+    mem_stream *s = ctx;
+    size_t n = s->len - s->pos;
+    if (n > len) {
+        n = len;
+    }
+    if (s->chunk && n > s->chunk) {
+        n = s->chunk;
+    }
+    memcpy(buf, s->data + s->pos, n);
+    s->pos += n;
+    return n;
+}
+
+static void assert_contains_all(hashmap* expected, const hashmap* actual)
+{
+    hm_iter it;
+    assert(hm_iter_begin(expected, &it) == HM_SUCCESS);
+    while (hm_iter_next(&it)) {
+        int value;
+        assert(get_n(actual, it.key, it.key_len, &value) == HM_SUCCESS && value == it.value);
+    }
+}
+
+static void assert_same(hashmap* expected, hashmap* actual)
+{
+    assert(expected->count == actual->count);
+    assert_contains_all(expected, actual);
+    assert_contains_all(actual, expected);
+}
+
+/**
+ * @brief Fills a map with n short keys and, between them, a few keys larger than a batch.
+ */
+static hashmap* make_map(const hashmap_options *opts, int n)
+{
+    hashmap* map = c_hashmap_ex(16, opts);
+    assert(map);
+    char key[32];
+    for (int i = 0; i < n; i++) {
+        int len = snprintf(key, sizeof(key), "key:%d", i);
+        assert(put_n(map, key, (size_t)len, i) == HM_SUCCESS);
+        if (i % 4000 == 0) {
+            size_t bigLen = HM_STREAM_BATCH_BYTES * 2 + (size_t)i;
+            char *big = malloc(bigLen);
+            assert(big);
+            memset(big, 'B', bigLen);
+            assert(put_n(map, big, bigLen, -i) == HM_SUCCESS);
+            free(big);
+        }
+    }
+    return map;
+}
+
+static void round_trip(const char *name, const hashmap_options *opts, int n)
+{
+    hashmap* map = make_map(opts, n);
+    mem_stream s = { 0 };
+    assert(hm_stream_write(map, mem_write, &s) == HM_SUCCESS);
+
+    hashmap* loaded = c_hashmap_ex(16, opts);
+    assert(loaded);
+    assert(hm_stream_read(loaded, mem_read, &s) == HM_SUCCESS);
+    assert_same(map, loaded);
+
+    // A few bytes per read call
+    s.pos = 0;
+    s.chunk = 7;
+    hashmap* chunked = c_hashmap(16);
+    assert(chunked);
+    assert(hm_stream_read(chunked, mem_read, &s) == HM_SUCCESS);
+    assert_same(map, chunked);
+
+    // Loading into a map that already holds keys updates those and keeps the others
+    s.pos = 0;
+    s.chunk = 0;
+    hashmap* merged = c_hashmap(16);
+    assert(merged);
+    assert(put(merged, "key:0", 12345) == HM_SUCCESS && put(merged, "extra", 1) == HM_SUCCESS);
+    assert(hm_stream_read(merged, mem_read, &s) == HM_SUCCESS);
+    int value;
+    assert(merged->count == map->count + (contains_key(map, "key:0") ? 1 : 2));
+    assert(get(merged, "extra", &value) == HM_SUCCESS && value == 1);
+    assert_contains_all(map, merged);
+
+    free(s.data);
+    d_hashmap(merged);
+    d_hashmap(chunked);
+    d_hashmap(loaded);
+    d_hashmap(map);
+    printf("%s: %d pairs round-trip\n", name, n);
+}
+
+/**
+ * @brief Cuts a small stream at every length short of complete; each must fail to load.
+ */
+static void truncations(void)
+{
+    hashmap* map = c_hashmap(16);
+    assert(map);
+    for (int i = 0; i < 20; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "k%d", i);
+        assert(put(map, key, i) == HM_SUCCESS);
+    }
+    mem_stream s = { 0 };
+    assert(hm_stream_write(map, mem_write, &s) == HM_SUCCESS);
+    size_t fullLen = s.len;
+    for (size_t len = 0; len < fullLen; len++) {
+        s.len = len;
+        s.pos = 0;
+        hashmap* loaded = c_hashmap(16);
+        assert(loaded);
+        assert(hm_stream_read(loaded, mem_read, &s) == HM_ERR_IO);
+        d_hashmap(loaded);
+    }
+
+    // A header claiming INT_MAX entries only presizes for HM_STREAM_MAX_PRESIZE of them
+    s.len = fullLen;
+    s.pos = 0;
+    hm_stream_header header;
+    memcpy(&header, s.data, sizeof(header));
+    header.count = INT32_MAX;
+    memcpy(s.data, &header, sizeof(header));
+    hashmap* loaded = c_hashmap(16);
+    assert(loaded);
+    assert(hm_stream_read(loaded, mem_read, &s) == HM_ERR_IO);
+    assert((size_t)loaded->size <= 2 * HM_STREAM_MAX_PRESIZE);
+    d_hashmap(loaded);
+
+    free(s.data);
+    d_hashmap(map);
+    printf("truncated and oversized streams are refused\n");
+}
+
+/**
+ * @brief Streams a snapshot map, saved to path, through a temporary file and back.
+ */
+static void through_files(const char *path)
+{
+    hashmap* map = make_map(&(hashmap_options){ .engine = HM_ENGINE_SWISS }, 5000);
+    assert(hm_save(map, path) == HM_SUCCESS);
+    hashmap* snap = hm_open_mmap(path);
+    assert(snap);
+
+    FILE *file = tmpfile();
+    assert(file);
+    assert(hm_stream_write(snap, hm_stream_file_write, file) == HM_SUCCESS);
+    rewind(file);
+    hashmap* loaded = c_hashmap(16);
+    assert(loaded);
+    assert(hm_stream_read(loaded, hm_stream_file_read, file) == HM_SUCCESS);
+    fclose(file);
+    assert_same(map, loaded);
+
+    d_hashmap(loaded);
+    d_hashmap(snap);
+    d_hashmap(map);
+    unlink(path);
+    printf("snapshot through a file: round-trips\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "stream_test.bin";
+    round_trip("empty", &(hashmap_options){ 0 }, 0);
+    round_trip("chained", &(hashmap_options){ 0 }, 20000);
+    round_trip("chained, incremental", &(hashmap_options){ .incremental = true }, 20000);
+    round_trip("swiss, arena", &(hashmap_options){ .engine = HM_ENGINE_SWISS, .arena = true }, 20000);
+    truncations();
+    through_files(path);
+    printf("ok\n");
+    return 0;
+}
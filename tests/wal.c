@@ -0,0 +1,306 @@
+// Checks that replaying a write-ahead log rebuilds the map it was written from: after resizes
+// that fail part-way through the writes, after a crash tore the last record, and after writes
+// and syncs of the log itself failed.
+// Build: gcc -O1 -pthread -I. -Wl,--wrap=malloc,--wrap=calloc,--wrap=write,--wrap=fsync tests/wal.c hashmap_wal.c hashmap.c hashmap_hash.c -o wal_test
+// Usage: ./wal_test [log_path]
+
+#include "hashmap_wal.h"
+
+#undef NDEBUG // The asserts are the test, and some of them make the calls being checked
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// While set, the library's allocations of at least FAIL_FROM_BYTES fail; keys and pairs are
+// smaller, bucket, control and slot arrays are not, so only resizes fail
+#define FAIL_FROM_BYTES 1024
+static bool failLargeAllocs;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    return failLargeAllocs && size >= FAIL_FROM_BYTES ? NULL : __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    return failLargeAllocs && n * size >= FAIL_FROM_BYTES ? NULL : __real_calloc(n, size);
+}
+
+// When set, the log's next write stores only half its bytes and the one after fails with
+// ENOSPC, as when the disk fills up mid-record; the next fsync fails with EIO
+static bool tearNextWrite;
+static bool failNextFsync;
+
+ssize_t __real_write(int fd, const void *buf, size_t len);
+int __real_fsync(int fd);
+
+ssize_t __wrap_write(int fd, const void *buf, size_t len)
+{
+    static bool failNext;
+    if (failNext) {
+        failNext = false;
+        errno = ENOSPC;
+        return -1;
+    }
+    if (tearNextWrite && len > 1) {
+        tearNextWrite = false;
+        failNext = true;
+        len /= 2;
+    }
+    return __real_write(fd, buf, len);
+}
+
+int __wrap_fsync(int fd)
+{
+    if (failNextFsync) {
+        failNextFsync = false;
+        errno = EIO;
+        return -1;
+    }
+    return __real_fsync(fd);
+}
+
+/**
+ * @brief Asserts that two maps hold the same pairs.
+ */
+static void assert_same(hashmap* expected, hashmap* actual)
+{
+    assert(expected->count == actual->count);
+    hm_iter it;
+    assert(hm_iter_begin(expected, &it) == HM_SUCCESS);
+    while (hm_iter_next(&it)) {
+        int value;
+        assert(get_n(actual, it.key, it.key_len, &value) == HM_SUCCESS);
+        assert(value == it.value);
+    }
+}
+
+/**
+ * @brief Replays the log at path into a fresh map of the same options.
+ */
+static hashmap* replay_into_new(const char *path, const hashmap_options *opts)
+{
+    hashmap* map = c_hashmap_ex(16, opts);
+    assert(map);
+    hm_wal* wal = hm_wal_open(path, map, NULL);
+    assert(wal);
+    assert(hm_wal_close(wal) == HM_SUCCESS);
+    return map;
+}
+
+/**
+ * @brief Makes every resize fail for a while and checks the log still matches the map.
+ */
+static void test_failed_resize(const char *path, HashMapEngine engine)
+{
+    hashmap_options opts = { .engine = engine };
+    unlink(path);
+    hashmap* map = c_hashmap_ex(16, &opts);
+    assert(map);
+    hm_wal* wal = hm_wal_open(path, map, NULL);
+    assert(wal);
+
+    char key[32];
+    for (int i = 0; i < 20; i++) {
+        snprintf(key, sizeof(key), "key:%d", i);
+        assert(hm_wal_put(wal, key, i) == HM_SUCCESS);
+    }
+
+    int failures = 0;
+    failLargeAllocs = true;
+    for (int i = 20; i < 400; i++) {
+        snprintf(key, sizeof(key), "key:%d", i);
+        HashMapStatus status = hm_wal_put(wal, key, i);
+        assert(status == HM_SUCCESS || status == HM_ERR_REHASHING_FAILED);
+        failures += status == HM_ERR_REHASHING_FAILED;
+        // Updates and deletes of keys already in the map never need to grow it
+        snprintf(key, sizeof(key), "key:%d", i / 2);
+        status = hm_wal_put(wal, key, -i);
+        assert(status == HM_SUCCESS || status == HM_ERR_REHASHING_FAILED);
+        if (i % 7 == 0) {
+            snprintf(key, sizeof(key), "key:%d", i / 3);
+            status = hm_wal_delete(wal, key);
+            assert(status == HM_SUCCESS || status == HM_ERR_KEY_NOT_FOUND);
+        }
+    }
+    failLargeAllocs = false;
+    assert(failures > 0);
+
+    for (int i = 400; i < 600; i++) {
+        snprintf(key, sizeof(key), "key:%d", i);
+        assert(hm_wal_put(wal, key, i) == HM_SUCCESS);
+    }
+    assert(hm_wal_close(wal) == HM_SUCCESS);
+
+    hashmap* replayed = replay_into_new(path, &opts);
+    assert_same(map, replayed);
+    assert_same(replayed, map);
+    d_hashmap(replayed);
+    d_hashmap(map);
+    printf("failed resize, engine %d: %d failed puts, log matches\n", (int)engine, failures);
+}
+
+/**
+ * @brief Cuts the log in the middle of its last record, as a crash during a write would, and
+ * checks that replay drops only that record and that appending continues after the cut.
+ */
+static void test_torn_tail(const char *path)
+{
+    unlink(path);
+    hashmap* map = c_hashmap(16);
+    assert(map);
+    hm_wal* wal = hm_wal_open(path, map, NULL);
+    assert(wal);
+    char key[32];
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "key:%d", i);
+        assert(hm_wal_put(wal, key, i) == HM_SUCCESS);
+    }
+    assert(hm_wal_delete(wal, "key:7") == HM_SUCCESS);
+    assert(hm_wal_close(wal) == HM_SUCCESS);
+
+    struct stat st;
+    assert(stat(path, &st) == 0);
+    off_t fullLen = st.st_size;
+    // The last record is the delete of "key:7"; cut it just past its header
+    assert(truncate(path, fullLen - 2) == 0);
+
+    hashmap* torn = c_hashmap(16);
+    assert(torn);
+    wal = hm_wal_open(path, torn, NULL);
+    assert(wal);
+    assert(wal->replayed == 100);
+    assert(torn->count == 100 && contains_key(torn, "key:7"));
+    // New records go after the last complete one, not after the torn bytes
+    assert(hm_wal_put(wal, "key:after", 1) == HM_SUCCESS);
+    assert(hm_wal_close(wal) == HM_SUCCESS);
+
+    // A record whose bytes were not all written reads back with a bad checksum
+    int fd = open(path, O_WRONLY);
+    assert(fd >= 0);
+    assert(stat(path, &st) == 0);
+    unsigned char garbage = 0xAB;
+    assert(pwrite(fd, &garbage, 1, st.st_size - 1) == 1);
+    close(fd);
+
+    hashmap* reopened = c_hashmap(16);
+    assert(reopened);
+    wal = hm_wal_open(path, reopened, NULL);
+    assert(wal);
+    assert(wal->replayed == 100 && !contains_key(reopened, "key:after"));
+    assert(hm_wal_close(wal) == HM_SUCCESS);
+    delete_key(torn, "key:after");
+    assert_same(torn, reopened);
+
+    d_hashmap(reopened);
+    d_hashmap(torn);
+    d_hashmap(map);
+    printf("torn tail: replay stops at the last complete record\n");
+}
+
+static off_t file_size(const char *path)
+{
+    struct stat st;
+    assert(stat(path, &st) == 0);
+    return st.st_size;
+}
+
+/**
+ * @brief Makes one write or fsync of the log fail and checks that the log refuses everything
+ * after it, that no torn bytes are left in the file, and that reopening replays exactly the
+ * operations committed before the failure and appends after them.
+ */
+static void test_failed_write(const char *path, int fault)
+{
+    unlink(path);
+    hashmap* map = c_hashmap(16);
+    assert(map);
+    hm_wal* wal = hm_wal_open(path, map, &(hm_wal_options){ .sync_every = fault == 1 ? 8 : 1 });
+    assert(wal);
+    char key[32];
+    for (int i = 0; i < 48; i++) {
+        snprintf(key, sizeof(key), "key:%d", i);
+        assert(hm_wal_put(wal, key, i) == HM_SUCCESS);
+    }
+    assert(hm_wal_sync(wal) == HM_SUCCESS);
+    off_t committedLen = file_size(path);
+
+    if (fault == 0) {
+        // A record torn by a full disk, committed on its own
+        tearNextWrite = true;
+        assert(hm_wal_put(wal, "torn", 1) == HM_ERR_IO);
+    } else if (fault == 1) {
+        // A group of buffered records torn while being flushed
+        for (int i = 0; i < 5; i++) {
+            assert(hm_wal_put(wal, "buffered", i) == HM_SUCCESS);
+        }
+        tearNextWrite = true;
+        assert(hm_wal_sync(wal) == HM_ERR_IO);
+    } else if (fault == 2) {
+        // A record too large for the buffer, written straight out
+        size_t bigLen = HM_WAL_BUFFER_SIZE * 2;
+        char *big = malloc(bigLen);
+        assert(big);
+        memset(big, 'B', bigLen);
+        tearNextWrite = true;
+        assert(hm_wal_put_n(wal, big, bigLen, 1) == HM_ERR_IO);
+        free(big);
+    } else {
+        failNextFsync = true;
+        assert(hm_wal_put(wal, "unsynced", 1) == HM_ERR_IO);
+        committedLen = file_size(path); // The record was written in full, just not synced
+    }
+    assert(wal->failed && file_size(path) == committedLen);
+
+    // Nothing gets through a failed log, and the map is left alone
+    int count = map->count;
+    assert(hm_wal_put(wal, "later", 1) == HM_ERR_IO);
+    assert(hm_wal_delete(wal, "key:0") == HM_ERR_IO);
+    assert(hm_wal_sync(wal) == HM_ERR_IO);
+    assert(map->count == count && !contains_key(map, "later") && contains_key(map, "key:0"));
+    assert(hm_wal_close(wal) == HM_ERR_IO);
+    assert(file_size(path) == committedLen);
+
+    hashmap* reopened = c_hashmap(16);
+    assert(reopened);
+    wal = hm_wal_open(path, reopened, NULL);
+    assert(wal);
+    assert(wal->replayed == 48 + (fault == 3));
+    for (int i = 48; i < 200; i++) {
+        snprintf(key, sizeof(key), "key:%d", i);
+        assert(hm_wal_put(wal, key, i) == HM_SUCCESS);
+    }
+    assert(hm_wal_close(wal) == HM_SUCCESS);
+
+    hashmap* replayed = c_hashmap(16);
+    assert(replayed);
+    wal = hm_wal_open(path, replayed, NULL);
+    assert(wal);
+    assert(hm_wal_close(wal) == HM_SUCCESS);
+    assert_same(reopened, replayed);
+    assert(replayed->count == 200 + (fault == 3));
+
+    d_hashmap(replayed);
+    d_hashmap(reopened);
+    d_hashmap(map);
+    printf("failed write, fault %d: the log stops at the last complete record\n", fault);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "wal_test.log";
+    test_failed_resize(path, HM_ENGINE_CHAINED);
+    test_failed_resize(path, HM_ENGINE_SWISS);
+    test_torn_tail(path);
+    for (int fault = 0; fault < 4; fault++) {
+        test_failed_write(path, fault);
+    }
+    unlink(path);
+    printf("ok\n");
+    return 0;
+}